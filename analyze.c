@@ -7,44 +7,25 @@
 /****************************************************/
 
 #include "globals.h"
+#include "util.h"
 #include "symtab.h"
+#include "pass.h"
 #include "analyze.h"
+#include "ast.h"
+#include "compiler.h"
 
-/* Conta a localizacao da variavel na memoria */
-static int location = 0;
-
-/* Funcao recursiva generica para percorrer a arvore sintatica.
-   Executa a funcao preProc em pre-ordem.
-   Executa a funcao postProc em pos-ordem. */
-static void traverse(TreeNode * t, void (* preProc) (TreeNode *), void (* postProc) (TreeNode *)) {
-  if (t != NULL) {
-    preProc(t); {
-      int i;
-      for (i=0; i < MAXCHILDREN; i++)
-        traverse(t->child[i],preProc,postProc);
-    }
-    postProc(t);
-    traverse(t->sibling,preProc,postProc);
-  }
-}
-
-/* Funcao que não faz nada */
-static void nullProc(TreeNode * t) {
-  if (t == NULL) return;
-  else return;
-}
-
-/* Insere os identificadores armazenados em t na tabela de simbolos */
-static void insertNode( TreeNode * t) {
+/* Insere os identificadores armazenados em t na tabela de simbolos e
+   guarda no no o simbolo da variavel. Depois de um erro sintatico o no
+   pode nao ter identificador (id -1, que a tabela hash usa para posicao
+   vazia); ele fica sem simbolo. */
+static void insertNode( PmCompiler * pm, TreeNode * t) {
   switch (t->nodekind) {
     case StmtK: /* Se for uma declaracao */
       switch (t->kind.stmt) {
         case AssignK: /* Atribuicao */
         case ReadK: /* Leitura */
-          if (st_lookup(t->attr.name) == -1) /* Ainda nao estah na tabela de simbolos */
-            st_insert(t->attr.name,t->lineno,location++, t->type);
-          else /* Ja esta na tabela de simbolos. Adicionar numero da linha */
-            st_insert(t->attr.name,t->lineno,0, t->type);
+          if (t->attr.id >= 0)
+            t->sym = st_find_or_insert(pm,t->attr.id,t->lineno,t->type);
           break;
         default:
           break;
@@ -53,10 +34,8 @@ static void insertNode( TreeNode * t) {
     case ExpK: /* Se for uma expressao */
       switch (t->kind.exp) {
         case IdK: /* Identificador */
-          if (st_lookup(t->attr.name) == -1) /* Ainda nao estah na tabela de simbolos */
-            st_insert(t->attr.name,t->lineno,location++, t->type);
-          else /* Ja esta na tabela de simbolos. Adicionar numero da linha */
-            st_insert(t->attr.name,t->lineno,0, t->type);
+          if (t->attr.id >= 0)
+            t->sym = st_find_or_insert(pm,t->attr.id,t->lineno,t->type);
           break;
         default:
           break;
@@ -67,23 +46,46 @@ static void insertNode( TreeNode * t) {
   }
 }
 
-/* Constroi a tabela de simbolos varrendo a arvore sintatica em pre-ordem */
-void buildSymtab(TreeNode * syntaxTree) {
-  traverse(syntaxTree,insertNode,nullProc);
+/* Mostra a tabela de simbolos depois que ela foi construida */
+static void finishSymtab(PmCompiler * pm) {
   if (TraceAnalyze) {
-    fprintf(listing,"\nSymbol table:\n\n");
-    printSymTab(listing);
+    fprintf(pm->listing,"\nSymbol table:\n\n");
+    printSymTab(pm,pm->listing);
+  }
+}
+
+/* Registra um erro de tipo. A mensagem so eh impressa no fim da passada
+   (flushTypeErrors), para que a listagem fique na mesma ordem quando a
+   checagem de tipo eh fundida com a construcao da tabela de simbolos,
+   que imprime a tabela so no fim do percurso. */
+static void typeError(PmCompiler * pm, TreeNode * t, char * message) {
+  pm->error = TRUE;
+  if (pm->nTypeErrors == pm->typeErrorsCapacity) {
+    int cap = pm->typeErrorsCapacity ? 2 * pm->typeErrorsCapacity : 64;
+    TypeErrorRec * grown = (TypeErrorRec *) realloc(pm->typeErrors, cap * sizeof(TypeErrorRec));
+    if (grown == NULL) { /* sem memoria: imprime ja */
+      fprintf(pm->listing,"Type error at line %d: %s\n",t->lineno,message);
+      return;
+    }
+    pm->typeErrors = grown;
+    pm->typeErrorsCapacity = cap;
   }
+  pm->typeErrors[pm->nTypeErrors].lineno = t->lineno;
+  pm->typeErrors[pm->nTypeErrors].message = message;
+  pm->nTypeErrors++;
 }
 
-/* Exibe mensagem de erro de tipo */
-static void typeError(TreeNode * t, char * message) {
-  fprintf(listing,"Type error at line %d: %s\n",t->lineno,message);
-  Error = TRUE;
+/* Imprime os erros de tipo registrados durante o percurso */
+static void flushTypeErrors(PmCompiler * pm) {
+  int i;
+  for (i = 0; i < pm->nTypeErrors; i++)
+    fprintf(pm->listing,"Type error at line %d: %s\n",
+            pm->typeErrors[i].lineno,pm->typeErrors[i].message);
+  pm->nTypeErrors = 0;
 }
 
 /* Faz a verificacao de tipo em um no da arvore */
-static void checkNode(TreeNode * t) {
+static void checkNode(PmCompiler * pm, TreeNode * t) {
   switch (t->nodekind) {
     case ExpK: /* No de expressao */
       switch (t->kind.exp) {
@@ -105,9 +107,10 @@ static void checkNode(TreeNode * t) {
             break;      
           }
           else
-          typeError(t,"Op applied to non-integer or non-real");
+          typeError(pm,t,"Op applied to non-integer or non-real");
+          break;
+        case ConstK: /* Constante: fica com o tipo do numero, usado por codeGen */
           break;
-        case ConstK: /* Constante */
         case IdK: /* Identificador */
           t->type = Integer;
           break;
@@ -120,31 +123,30 @@ static void checkNode(TreeNode * t) {
         case IfK: /* Declaracao IF */
         case WhileK:
           if (t->child[0]->type == Integer || t->child[0]->type == Real)
-            typeError(t->child[0],"if test is not Boolean");
+            typeError(pm,t->child[0],"if test is not Boolean");
           break;
-        case AssignK: /* Declaracao de atribuicao */
-          if (t->child[0]->type == Integer || t->child[0]->type == Real) {
-            t->child[0]->type = t->type;
+        case AssignK: /* Declaracao de atribuicao. O valor fica com o
+                         seu tipo: codeGen converte para o da variavel */
+          if (t->child[0]->type == Integer || t->child[0]->type == Real)
             break;
-          }
           else 
-            typeError(t->child[0],"assignment of non-integer or non-real value");
+            typeError(pm,t->child[0],"assignment of non-integer or non-real value");
           break;
         case WriteK: /* Declaracao WRITE */
           if (t->child[0]->type == Integer || t->child[0]->type == Real)
             break;
           else
-            typeError(t->child[0],"write of non-integer or non-real value");
-            break;
+            typeError(pm,t->child[0],"write of non-integer or non-real value");
+          break;
         /* case ReadK:
           if (t->child[0]->type == Integer || t->child[0]->type == Real)
             break;
           else
-            typeError(t->child[0],"write of non-integer or non-real value");
+            typeError(pm,t->child[0],"write of non-integer or non-real value");
             break; */
         case RepeatK:  /* Declaracao REPÈAT */
           if (t->child[1]->type == Integer || t->child[1]->type == Real)
-            typeError(t->child[1],"repeat test is not Boolean");
+            typeError(pm,t->child[1],"repeat test is not Boolean");
           break;
         default:
           break;
@@ -155,7 +157,122 @@ static void checkNode(TreeNode * t) {
   }
 }
 
+/* Passadas da analise semantica */
+static const Pass symtabPass = {"buildSymtab", insertNode, NULL, finishSymtab, 0};
+static const Pass typeCheckPass = {"typeCheck", NULL, checkNode, flushTypeErrors, 0};
+
+/* Constroi a tabela de simbolos varrendo a arvore sintatica em pre-ordem */
+void buildSymtab(PmCompiler * pm, TreeNode * syntaxTree) {
+  PassManager pmgr;
+  initPasses(&pmgr);
+  addPass(&pmgr,&symtabPass);
+  runPasses(pm,&pmgr,syntaxTree);
+}
+
 /* Faz a checagem de tipo varrendo a arvore sintatica em pos-ordem */
-void typeCheck(TreeNode * syntaxTree) {
-  traverse(syntaxTree,nullProc,checkNode);
+void typeCheck(PmCompiler * pm, TreeNode * syntaxTree) {
+  PassManager pmgr;
+  initPasses(&pmgr);
+  addPass(&pmgr,&typeCheckPass);
+  runPasses(pm,&pmgr,syntaxTree);
+}
+
+/* Registra as passadas de buildSymtab e typeCheck */
+void addSemanticPasses(PassManager * pmgr) {
+  addPass(pmgr,&symtabPass);
+  addPass(pmgr,&typeCheckPass);
+}
+
+/* buildSymtab e typeCheck num unico percurso. A insercao de um no so
+   le o tipo do proprio no, que a checagem so altera na pos-ordem dele,
+   entao a tabela sai igual a das passadas separadas. */
+void analyze(PmCompiler * pm, TreeNode * syntaxTree) {
+  PassManager pmgr;
+  initPasses(&pmgr);
+  addSemanticPasses(&pmgr);
+  runPasses(pm,&pmgr,syntaxTree);
+}
+
+/*************************************************/
+/*********  Passadas na arvore compacta  *********/
+/*************************************************/
+
+/* insertNode para a arvore compacta. O simbolo nao eh guardado, porque
+   os arrays da arvore podem ser os de um arquivo mapeado (astMap). */
+static void insertAstNode(PmCompiler * pm, AstTree * a, unsigned int n) {
+  unsigned char k = a->kind[n];
+  if (k == AST_KIND(StmtK,AssignK) || k == AST_KIND(StmtK,ReadK) ||
+      k == AST_KIND(ExpK,IdK))
+    st_find_or_insert(pm,a->attr[n],a->lineno[n],(ExpType) a->type[n]);
+}
+
+/* Constroi a tabela de simbolos varrendo a arvore compacta em pre-ordem */
+int buildSymtabAst(PmCompiler * pm, AstTree * a) {
+  if (!walkAst(pm,a,a->root,insertAstNode,NULL))
+    return FALSE;
+  if (TraceAnalyze) {
+    fprintf(pm->listing,"\nSymbol table:\n\n");
+    printSymTab(pm,pm->listing);
+  }
+  return TRUE;
+}
+
+/* typeError para a arvore compacta */
+static void typeAstError(PmCompiler * pm, AstTree * a, unsigned int n, char * message) {
+  fprintf(pm->listing,"Type error at line %d: %s\n",a->lineno[n],message);
+  pm->error = TRUE;
+}
+
+/* checkNode para a arvore compacta. Um filho ausente eh o no
+   AST_NULL, de tipo Void. */
+static void checkAstNode(PmCompiler * pm, AstTree * a, unsigned int n) {
+  unsigned int c0 = a->links[n].child[0], c1 = a->links[n].child[1];
+  unsigned char * type = a->type;
+  switch (a->kind[n]) {
+    case AST_KIND(ExpK,OpK): { /* Tipo operador */
+      TokenType op = (TokenType) a->attr[n];
+      if ((op == IGUAL) || (op == NAO_IGUAL) || (op == MENOR_QUE) || (op == MENOR_QUE_IGUAL) || (op == MAIOR_QUE) || (op == MAIOR_QUE_IGUAL))
+        type[n] = Boolean;
+      else if ((type[c0] == Integer) || (type[c1] == Integer))
+        type[n] = Integer;
+      else if ((type[c0] == Integer) || (type[c1] == Real))
+        type[n] = Real;
+      else if ((type[c0] == Real) || (type[c1] == Integer))
+        type[n] = Real;
+      else if ((type[c0] == Real) || (type[c1] == Real))
+        type[n] = Real;
+      else
+        typeAstError(pm,a,n,"Op applied to non-integer or non-real");
+      break;
+    }
+    case AST_KIND(ExpK,ConstK): /* Constante: fica com o tipo do numero */
+      break;
+    case AST_KIND(ExpK,IdK): /* Identificador */
+      type[n] = Integer;
+      break;
+    case AST_KIND(StmtK,IfK): /* Declaracao IF */
+    case AST_KIND(StmtK,WhileK):
+      if (type[c0] == Integer || type[c0] == Real)
+        typeAstError(pm,a,c0,"if test is not Boolean");
+      break;
+    case AST_KIND(StmtK,AssignK): /* Declaracao de atribuicao */
+      if (!(type[c0] == Integer || type[c0] == Real))
+        typeAstError(pm,a,c0,"assignment of non-integer or non-real value");
+      break;
+    case AST_KIND(StmtK,WriteK): /* Declaracao WRITE */
+      if (!(type[c0] == Integer || type[c0] == Real))
+        typeAstError(pm,a,c0,"write of non-integer or non-real value");
+      break;
+    case AST_KIND(StmtK,RepeatK): /* Declaracao REPEAT */
+      if (type[c1] == Integer || type[c1] == Real)
+        typeAstError(pm,a,c1,"repeat test is not Boolean");
+      break;
+    default:
+      break;
+  }
+}
+
+/* Faz a checagem de tipo varrendo a arvore compacta em pos-ordem */
+int typeCheckAst(PmCompiler * pm, AstTree * a) {
+  return walkAst(pm,a,a->root,NULL,checkAstNode);
 }
@@ -9,9 +9,23 @@
 #define _ANALYZE_H_
 
 /* Constroi a tabela de simbolos varrendo a arvore sintatica em pre-ordem */
-void buildSymtab(TreeNode *);
+void buildSymtab(PmCompiler *, TreeNode *);
 
 /* Faz a checagem de tipo varrendo a arvore sintatica em pos-ordem */
-void typeCheck(TreeNode *);
+void typeCheck(PmCompiler *, TreeNode *);
+
+/* buildSymtab e typeCheck fundidos num unico percurso da arvore, com a
+   mesma listagem das duas chamadas em sequencia */
+void analyze(PmCompiler *, TreeNode *);
+
+/* Registra as passadas de buildSymtab e typeCheck em pmgr (pass.h), para
+   que outras passadas, como verificacoes extras, compartilhem o mesmo
+   percurso */
+void addSemanticPasses(PassManager *);
+
+/* buildSymtab e typeCheck sobre a arvore compacta (ast.h). Retornam
+   FALSE se a arvore mapeada for invalida (walkAst, util.h). */
+int buildSymtabAst(PmCompiler *, AstTree *);
+int typeCheckAst(PmCompiler *, AstTree *);
 
 #endif
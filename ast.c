@@ -0,0 +1,367 @@
+/****************************************************/
+/* File: ast.c                                      */
+/* Compact syntax tree for the P- compiler          */
+/****************************************************/
+
+#include "globals.h"
+#include "ast.h"
+#include "intern.h"
+#include "compiler.h"
+
+#include <limits.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/* Dobra a capacidade dos arrays de nos */
+static int growNodes(PmCompiler * pm, AstTree * a) {
+  int cap = a->capacity ? 2 * a->capacity : 1024;
+  AstLinks * links = realloc(a->links, cap * sizeof(*a->links));
+  unsigned char * kind = (links != NULL) ? realloc(a->kind, cap * sizeof(*a->kind)) : NULL;
+  unsigned char * type = (kind != NULL) ? realloc(a->type, cap * sizeof(*a->type)) : NULL;
+  int * lineno = (type != NULL) ? realloc(a->lineno, cap * sizeof(*a->lineno)) : NULL;
+  int * attr = (lineno != NULL) ? realloc(a->attr, cap * sizeof(*a->attr)) : NULL;
+  if (links != NULL) a->links = links;
+  if (kind != NULL) a->kind = kind;
+  if (type != NULL) a->type = type;
+  if (lineno != NULL) a->lineno = lineno;
+  if (attr == NULL) {
+    fprintf(pm->listing,"Out of memory error building compact tree\n");
+    return FALSE;
+  }
+  a->attr = attr;
+  a->capacity = cap;
+  return TRUE;
+}
+
+/* Guarda o valor de uma constante e retorna o seu indice */
+static int addConst(PmCompiler * pm, AstTree * a, NumValue v) {
+  if (a->nconsts == a->constsCapacity) {
+    int cap = a->constsCapacity ? 2 * a->constsCapacity : 256;
+    NumValue * consts = realloc(a->consts, cap * sizeof(*a->consts));
+    if (consts == NULL) {
+      fprintf(pm->listing,"Out of memory error building compact tree\n");
+      return -1;
+    }
+    a->consts = consts;
+    a->constsCapacity = cap;
+  }
+  a->consts[a->nconsts] = v;
+  return a->nconsts++;
+}
+
+/* Acrescenta uma copia do no t, sem ligacoes, e retorna o seu indice,
+   ou AST_NULL se faltar memoria */
+static unsigned int copyNode(PmCompiler * pm, TreeNode * t, AstTree * a) {
+  unsigned int n;
+  if (a->count == a->capacity && !growNodes(pm, a))
+    return AST_NULL;
+  n = a->count++;
+  a->kind[n] = t->nodekind == StmtK ? AST_KIND(StmtK, t->kind.stmt)
+                                    : AST_KIND(ExpK, t->kind.exp);
+  a->type[n] = (unsigned char) t->type;
+  a->lineno[n] = t->lineno;
+  if (t->nodekind == ExpK && t->kind.exp == OpK)
+    a->attr[n] = t->attr.op;
+  else if (t->nodekind == ExpK && t->kind.exp == ConstK) {
+    if ((a->attr[n] = addConst(pm, a, t->attr.val)) < 0)
+      return AST_NULL;
+  }
+  else
+    a->attr[n] = t->attr.id;
+  a->links[n].child[0] = a->links[n].child[1] = a->links[n].child[2] = AST_NULL;
+  a->links[n].sibling = AST_NULL;
+  return n;
+}
+
+/* Nivel da pilha da copia: o no original, a sua copia e o proximo filho */
+typedef struct {
+  TreeNode * t;
+  unsigned int n;
+  int child;
+} FlattenFrame;
+
+/* Copia a arvore t para a. O percurso eh o de walkTree (util.c), com
+   pilha explicita, e numera os nos em pre-ordem. */
+int flattenTree(PmCompiler * pm, TreeNode * t, AstTree * a) {
+  FlattenFrame * stack, * grown;
+  int sp = 0, capacity = 64, ok = TRUE;
+  if (a->mapping != NULL)
+    freeAst(a);
+  a->count = 0;
+  a->nconsts = 0;
+  if (a->capacity == 0 && !growNodes(pm, a))
+    return FALSE;
+  /* no 0: o "NULL", com tipo Void */
+  a->links[0].child[0] = a->links[0].child[1] = a->links[0].child[2] = AST_NULL;
+  a->links[0].sibling = AST_NULL;
+  a->kind[0] = 0;
+  a->type[0] = Void;
+  a->lineno[0] = 0;
+  a->attr[0] = -1;
+  a->count = 1;
+  a->root = AST_NULL;
+  if (t == NULL)
+    return TRUE;
+  if ((stack = (FlattenFrame *) malloc(capacity * sizeof(FlattenFrame))) == NULL ||
+      (a->root = copyNode(pm, t, a)) == AST_NULL) {
+    free(stack);
+    return FALSE;
+  }
+  stack[sp].t = t;
+  stack[sp].n = a->root;
+  stack[sp++].child = 0;
+  while (sp > 0 && ok) {
+    FlattenFrame * f = &stack[sp-1];
+    unsigned int n;
+    if (f->child < MAXCHILDREN) { /* copia o proximo filho */
+      TreeNode * c = f->t->child[f->child];
+      if (c == NULL) {
+        f->child++;
+        continue;
+      }
+      if (sp == capacity) {
+        grown = (FlattenFrame *) realloc(stack, 2 * capacity * sizeof(FlattenFrame));
+        if (grown == NULL) {
+          fprintf(pm->listing,"Out of memory error building compact tree\n");
+          ok = FALSE;
+          break;
+        }
+        stack = grown;
+        capacity *= 2;
+        f = &stack[sp-1];
+      }
+      if ((n = copyNode(pm, c, a)) == AST_NULL)
+        ok = FALSE;
+      else {
+        a->links[f->n].child[f->child++] = n;
+        stack[sp].t = c;
+        stack[sp].n = n;
+        stack[sp++].child = 0;
+      }
+    } else if (f->t->sibling != NULL) { /* passa para o irmao no mesmo nivel */
+      if ((n = copyNode(pm, f->t->sibling, a)) == AST_NULL)
+        ok = FALSE;
+      else {
+        a->links[f->n].sibling = n;
+        f->t = f->t->sibling;
+        f->n = n;
+        f->child = 0;
+      }
+    } else
+      sp--;
+  }
+  free(stack);
+  return ok;
+}
+
+/* Memoria ocupada pelos nos e constantes */
+long astBytes(AstTree * a) {
+  return (long) a->count * (sizeof(AstLinks) + 2 + 2 * sizeof(int)) +
+         (long) a->nconsts * sizeof(NumValue);
+}
+
+/*************************************************/
+/*************  Arquivo .ast (ast.h)  ************/
+/*************************************************/
+
+/* Alinhamento das secoes do arquivo */
+#define AST_ALIGN 8
+
+#define AST_ROUND(n) (((n) + AST_ALIGN - 1) / AST_ALIGN * AST_ALIGN)
+
+/* Tamanho da secao s, sem o alinhamento */
+static long long sectionBytes(const AstFileHeader * h, int s) {
+  switch (s) {
+    case AST_LINKS: return (long long) h->count * sizeof(AstLinks);
+    case AST_KINDS:
+    case AST_TYPES: return h->count;
+    case AST_LINES:
+    case AST_ATTRS: return (long long) h->count * sizeof(int);
+    case AST_CONSTS: return (long long) h->nconsts * sizeof(NumValue);
+    case AST_NAMES: return ((long long) h->nnames + 1) * sizeof(unsigned int);
+    default: return h->stringBytes;
+  }
+}
+
+/* Completa com zeros uma secao de n bytes ate o alinhamento */
+static int writePadding(FILE * f, long long n) {
+  static const char zeros[AST_ALIGN];
+  size_t pad = (size_t) (AST_ROUND(n) - n);
+  return pad == 0 || fwrite(zeros, 1, pad, f) == pad;
+}
+
+/* Grava uma secao de n bytes */
+static int writeSection(FILE * f, const void * data, long long n) {
+  return (n == 0 || fwrite(data, 1, (size_t) n, f) == (size_t) n) && writePadding(f, n);
+}
+
+/* Grava a arvore compacta e os nomes num arquivo .ast */
+int astWrite(PmCompiler * pm, AstTree * a, const char * fileName,
+             long long sourceSize, long long sourceTime) {
+  AstFileHeader h;
+  const void * data[AST_STRINGS];
+  unsigned int * names;
+  long long at;
+  int nnames = internCount(pm), i, ok;
+  FILE * f;
+  if ((names = (unsigned int *) malloc((nnames + 1) * sizeof(unsigned int))) == NULL) {
+    fprintf(pm->listing,"Out of memory error writing %s\n",fileName);
+    return FALSE;
+  }
+  names[0] = 0;
+  for (i = 0; i < nnames; i++)
+    names[i+1] = names[i] + (unsigned int) strlen(internString(pm,i)) + 1;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, AST_MAGIC, sizeof(h.magic));
+  h.version = AST_VERSION;
+  h.byteOrder = AST_BYTE_ORDER;
+  h.headerSize = sizeof(h);
+  h.constSize = sizeof(NumValue);
+  h.count = a->count;
+  h.root = a->root;
+  h.nconsts = a->nconsts;
+  h.nnames = nnames;
+  h.stringBytes = names[nnames];
+  h.sourceSize = sourceSize;
+  h.sourceTime = sourceTime;
+  data[AST_LINKS] = a->links;
+  data[AST_KINDS] = a->kind;
+  data[AST_TYPES] = a->type;
+  data[AST_LINES] = a->lineno;
+  data[AST_ATTRS] = a->attr;
+  data[AST_CONSTS] = a->consts;
+  data[AST_NAMES] = names; /* os nomes sao gravados um a um */
+  at = AST_ROUND((long long) sizeof(h));
+  for (i = 0; i < AST_SECTIONS; i++) {
+    h.offset[i] = at;
+    at += AST_ROUND(sectionBytes(&h, i));
+  }
+  h.fileSize = at;
+  if ((f = fopen(fileName, "wb")) == NULL) {
+    free(names);
+    return FALSE;
+  }
+  ok = writeSection(f, &h, sizeof(h));
+  for (i = 0; ok && i < AST_STRINGS; i++)
+    ok = writeSection(f, data[i], sectionBytes(&h, i));
+  for (i = 0; ok && i < nnames; i++)
+    ok = fwrite(internString(pm,i), 1, names[i+1] - names[i], f) == names[i+1] - names[i];
+  ok = ok && writePadding(f, h.stringBytes);
+  ok = (fclose(f) == 0) && ok;
+  free(names);
+  if (!ok)
+    remove(fileName);
+  return ok;
+}
+
+/* Mapeia o arquivo inteiro em paginas privadas, copiadas so quando
+   escritas (sem mmap, le o arquivo para a memoria). Retorna NULL se nao
+   conseguir. */
+static void * mapFile(const char * fileName, long * size) {
+  struct stat st;
+  void * p = NULL;
+  FILE * f = fopen(fileName, "rb");
+  if (f == NULL)
+    return NULL;
+  if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+    *size = (long) st.st_size;
+#ifndef _WIN32
+    p = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+    if (p == MAP_FAILED)
+      p = NULL;
+#else
+    if ((p = malloc((size_t) st.st_size)) != NULL &&
+        fread(p, 1, (size_t) st.st_size, f) != (size_t) st.st_size) {
+      free(p);
+      p = NULL;
+    }
+#endif
+  }
+  fclose(f);
+  return p;
+}
+
+static void unmapFile(void * p, long size) {
+#ifndef _WIN32
+  munmap(p, (size_t) size);
+#else
+  free(p);
+#endif
+}
+
+/* Confere o cabecalho e os limites das secoes */
+static int validHeader(const AstFileHeader * h, long size) {
+  int i;
+  if (size < (long) sizeof(*h) || memcmp(h->magic, AST_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != AST_VERSION || h->byteOrder != AST_BYTE_ORDER ||
+      h->headerSize != sizeof(*h) || h->constSize != sizeof(NumValue) ||
+      h->fileSize != size || h->count < 1 || h->count > INT_MAX || h->root >= h->count)
+    return FALSE;
+  for (i = 0; i < AST_SECTIONS; i++)
+    if (h->offset[i] < (long long) sizeof(*h) || h->offset[i] % AST_ALIGN != 0 ||
+        h->offset[i] + sectionBytes(h, i) > size)
+      return FALSE;
+  return TRUE;
+}
+
+/* Mapeia um arquivo .ast e insere os seus nomes na tabela de pm */
+int astMap(PmCompiler * pm, AstTree * a, const char * fileName,
+           long long sourceSize, long long sourceTime) {
+  const AstFileHeader * h;
+  const unsigned int * names;
+  const char * strings;
+  char * base;
+  long size = 0;
+  int i;
+  if ((base = (char *) mapFile(fileName, &size)) == NULL)
+    return FALSE;
+  h = (const AstFileHeader *) base;
+  /* o no 0 faz o papel de filho ausente, com tipo Void */
+  if (!validHeader(h, size) || internCount(pm) != 0 ||
+      (sourceSize >= 0 && (h->sourceSize != sourceSize || h->sourceTime != sourceTime)) ||
+      (unsigned char) base[h->offset[AST_TYPES]] != Void) {
+    unmapFile(base, size);
+    return FALSE;
+  }
+  names = (const unsigned int *) (base + h->offset[AST_NAMES]);
+  strings = base + h->offset[AST_STRINGS];
+  for (i = 0; i < (int) h->nnames; i++)
+    if (names[i+1] <= names[i] || names[i+1] > h->stringBytes || strings[names[i+1] - 1] != '\0' ||
+        internName(pm, strings + names[i], (int) (names[i+1] - names[i] - 1)) != i) {
+      internClear(pm);
+      unmapFile(base, size);
+      return FALSE;
+    }
+  freeAst(a);
+  a->links = (AstLinks *) (base + h->offset[AST_LINKS]);
+  a->kind = (unsigned char *) (base + h->offset[AST_KINDS]);
+  a->type = (unsigned char *) (base + h->offset[AST_TYPES]);
+  a->lineno = (int *) (base + h->offset[AST_LINES]);
+  a->attr = (int *) (base + h->offset[AST_ATTRS]);
+  a->consts = (NumValue *) (base + h->offset[AST_CONSTS]);
+  a->root = h->root;
+  a->count = a->capacity = (int) h->count;
+  a->nconsts = a->constsCapacity = (int) h->nconsts;
+  a->mapping = base;
+  a->mappedSize = size;
+  a->verified = FALSE;
+  return TRUE;
+}
+
+/* Libera os arrays, ou desfaz o mapeamento */
+void freeAst(AstTree * a) {
+  if (a->mapping != NULL)
+    unmapFile(a->mapping, a->mappedSize);
+  else {
+    free(a->links);
+    free(a->kind);
+    free(a->type);
+    free(a->lineno);
+    free(a->attr);
+    free(a->consts);
+  }
+  memset(a, 0, sizeof(*a));
+}
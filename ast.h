@@ -0,0 +1,107 @@
+/****************************************************/
+/* File: ast.h                                      */
+/* Compact syntax tree for the P- compiler          */
+/****************************************************/
+
+#ifndef _AST_H_
+#define _AST_H_
+
+/* Arvore sintatica compacta: os nos ficam em arrays contiguos e sao
+   referenciados por indices de 32 bits em vez de ponteiros. O no i tem
+   filhos links[i].child[], proximo irmao links[i].sibling, tipo de no
+   kind[i] (nodekind e kind no mesmo byte), tipo de expressao type[i],
+   linha lineno[i] e atributo attr[i]. O atributo eh o operador (OpK), o
+   id do nome (IdK, AssignK, ReadK) ou o indice do valor em consts
+   (ConstK). O indice AST_NULL faz o papel de NULL; o no 0 existe so para
+   que type[AST_NULL] seja Void. Os nos sao numerados em pre-ordem, entao
+   um no e os seus filhos ficam proximos na memoria. */
+
+#define AST_NULL 0
+
+/* nodekind nos bits altos e StmtKind ou ExpKind nos 3 bits baixos */
+#define AST_KIND(nodekind,kind) ((unsigned char) (((nodekind) << 3) | (kind)))
+#define AST_NODEKIND(k) ((NodeKind) ((k) >> 3))
+#define AST_STMT(k) ((StmtKind) ((k) & 7))
+#define AST_EXP(k) ((ExpKind) ((k) & 7))
+
+typedef struct {
+  unsigned int child[MAXCHILDREN];
+  unsigned int sibling;
+} AstLinks;
+
+struct AstTree {
+  AstLinks *links;
+  unsigned char *kind;
+  unsigned char *type; /* ExpType */
+  int *lineno;
+  int *attr;
+  NumValue *consts; /* valores das constantes */
+  unsigned int root; /* primeiro comando do programa */
+  int count, capacity; /* nos, incluindo o no 0 */
+  int nconsts, constsCapacity;
+  void *mapping; /* arquivo mapeado por astMap, ou NULL */
+  long mappedSize;
+  int verified; /* arvore mapeada ja percorrida inteira por walkAst */
+};
+
+/* Arquivo .ast: a arvore compacta gravada por astWrite para ser mapeada
+   de volta por astMap sem varrer nem analisar o fonte de novo. Depois
+   do cabecalho vem cada array, na mesma representacao da memoria e
+   alinhado em 8 bytes, na ordem de AstSection. offset[] eh contado do
+   inicio do arquivo, entao o conteudo nao depende do endereco em que eh
+   mapeado. Os nomes sao a tabela de intern.h: names tem nnames + 1
+   deslocamentos (unsigned int) em strings, e o nome do id i comeca em
+   names[i] e termina com um '\0' logo antes de names[i+1]. */
+
+#define AST_MAGIC "PMAST\r\n" /* 8 bytes, com o '\0' */
+#define AST_VERSION 1
+#define AST_BYTE_ORDER 0x01020304u
+
+typedef enum {
+  AST_LINKS, AST_KINDS, AST_TYPES, AST_LINES, AST_ATTRS, AST_CONSTS,
+  AST_NAMES, AST_STRINGS, AST_SECTIONS
+} AstSection;
+
+typedef struct {
+  char magic[8];
+  unsigned int version;
+  unsigned int byteOrder; /* AST_BYTE_ORDER na ordem de quem gravou */
+  unsigned int headerSize; /* sizeof(AstFileHeader) */
+  unsigned int constSize; /* sizeof(NumValue) */
+  unsigned int count, root, nconsts, nnames;
+  long long stringBytes;
+  long long sourceSize, sourceTime; /* identificam o fonte (astWrite) */
+  long long fileSize;
+  long long offset[AST_SECTIONS];
+} AstFileHeader;
+
+/* Copia a arvore t para a, reaproveitando os arrays que a ja tiver
+   (ou desfazendo o mapeamento, se a veio de astMap). Retorna FALSE se
+   faltar memoria. */
+int flattenTree(PmCompiler *, TreeNode *, AstTree *);
+
+/* Memoria ocupada pelos nos e constantes de a, em bytes */
+long astBytes(AstTree *);
+
+/* Libera os arrays de a, ou desfaz o mapeamento */
+void freeAst(AstTree *);
+
+/* Grava a em fileName com os nomes de pm. sourceSize e sourceTime sao
+   guardados para que astMap reconheca o fonte (por exemplo, o tamanho e
+   a data de modificacao em nanossegundos). Retorna FALSE se nao conseguir gravar. */
+int astWrite(PmCompiler *, AstTree *, const char * fileName,
+             long long sourceSize, long long sourceTime);
+
+/* Mapeia fileName em a, sem copiar nem converter os nos: os arrays de a
+   apontam para dentro do arquivo, em paginas copiadas so quando escritas
+   (typeCheckAst altera os tipos). Os nomes sao inseridos na tabela de
+   pm, que deve estar vazia, para que os ids sejam os do arquivo. Retorna
+   FALSE se o arquivo nao existir, for de outra versao ou maquina, estiver
+   truncado ou invalido ou, com sourceSize >= 0, for de outro fonte. Aqui
+   so o cabecalho e os nomes sao conferidos, em tempo proporcional aos
+   nomes; os nos sao conferidos por walkAst no primeiro percurso (util.h),
+   que retorna FALSE se a arvore for invalida. */
+int astMap(PmCompiler *, AstTree *, const char * fileName,
+           long long sourceSize, long long sourceTime);
+
+#endif
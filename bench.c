@@ -0,0 +1,470 @@
+/****************************************************/
+/* File: bench.c                                    */
+/* Medicao de desempenho do compilador P-           */
+/* Uso: bench [-r repeticoes] [-m] [-f fases]      */
+/*            [-j threads] [-s simbolos] arquivos...*/
+/****************************************************/
+
+/* Mede cada fase separadamente sobre cada arquivo: getToken (varredura
+   token a token), parse (analise sintatica do fluxo ja varrido por
+   scanAll), buildSymtab, typeCheck, printTree (para um arquivo nulo) e
+   codeGen (so na memoria, sem arquivo de codigo).
+   As fases com sufixo Ast sao as mesmas passadas sobre a arvore compacta
+   (ast.h), que flatten copia da arvore de ponteiros. mapAst mede
+   astMap sobre a arvore gravada por astWrite (sem medir, em bench.ast
+   no diretorio corrente). traverse e traverseAst medem so o percurso
+   (walkTree e walkAst), com uma visita que nao faz nada. analyze eh
+   buildSymtab e typeCheck fundidos num unico percurso. reparse mede
+   edicoes de um caractere na reanalise incremental (incr.h). scanParse
+   eh parse com a varredura, para comparar com parseParallel, que divide
+   o fonte em ate -j pedacos (padrao 4; pparse.h). O cabecalho de cada
+   arquivo mostra a memoria das duas arvores.
+   Cada fase eh executada repeticoes vezes e vale o melhor tempo.
+   A vazao eh dada em MB/s do fonte e em itens/s, onde os itens sao
+   tokens para getToken e nos da arvore para as demais fases; reparse
+   mostra o tempo de cada edicao e edicoes/s.
+   Com -m a saida eh CSV, uma linha por arquivo e fase, para
+   acompanhar regressoes. -f limita a medicao as fases da lista
+   separada por virgulas (ex.: -f getToken,parse). Os programas de teste podem ser gerados com
+   gerapm.
+   -s mede antes a tabela de simbolos sozinha, para cada quantidade de
+   variaveis da lista (ex.: -s 1000,1000000): a insercao de cada uma, uma
+   segunda citacao, a busca em ordem aleatoria e a busca de nomes
+   ausentes, em ns por operacao. Nesse caso os arquivos sao opcionais. */
+
+#include "util.c"
+#include "intern.c"
+#include "pass.c"
+#include "ast.c"
+#include "scan.c"
+#include "parse.c"
+#include "pparse.c"
+#include "symtab.c"
+#include "analyze.c"
+#include "compiler.c"
+#include "incr.c"
+#include "cgen.c"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+
+/* Fases medidas, na ordem em que sao executadas */
+typedef enum {
+    F_GETTOKEN, F_PARSE, F_FLATTEN, F_MAPAST, F_TRAVERSE, F_TRAVERSEAST,
+    F_ANALYZE, F_BUILDSYMTAB, F_TYPECHECK, F_PRINTTREE, F_CODEGEN,
+    F_BUILDSYMTABAST, F_TYPECHECKAST, F_PRINTTREEAST, F_REPARSE,
+    F_SCANPARSE, F_PARSEPARALLEL, NPHASES
+} Phase;
+
+static const char *phaseName[NPHASES] = {
+    "getToken", "parse", "flatten", "mapAst", "traverse", "traverseAst",
+    "analyze", "buildSymtab", "typeCheck", "printTree", "codeGen",
+    "buildSymtabAst", "typeCheckAst", "printTreeAst", "reparse",
+    "scanParse", "parseParallel"
+};
+
+/* Arquivo temporario da fase mapAst */
+#define BENCH_AST "bench.ast"
+
+/* Edicoes feitas na fase reparse */
+#define REPARSE_EDITS 2000
+
+/* Fases selecionadas com -f */
+static int selected[NPHASES];
+
+/* Pedacos da fase parseParallel (-j) */
+static int parseThreads = 4;
+
+/* Quantidades de variaveis da medicao da tabela de simbolos (-s) */
+#define MAXSYMSIZES 16
+static long symSizes[MAXSYMSIZES];
+static int nsymSizes;
+
+/* Arvore compacta, reaproveitada entre os arquivos */
+static AstTree ast;
+
+/* Visitas que nao fazem nada alem de contar, para medir o percurso */
+static long visited;
+
+static void visitNode(PmCompiler *pm, TreeNode *t) {
+    (void) pm;
+    (void) t;
+    visited++;
+}
+
+static void visitAstNode(PmCompiler *pm, AstTree *a, unsigned int n) {
+    (void) pm;
+    (void) a;
+    (void) n;
+    visited++;
+}
+
+/* Relogio de parede em segundos */
+static double now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double) c.QuadPart / (double) f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+
+static void openSource(PmCompiler *pm, const char *fileName) {
+    resetCompiler(pm);
+    if ((pm->source = fopen(fileName, "r")) == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+    if (!scanOpen(pm, pm->source)) exit(1);
+}
+
+static int anySelected(Phase first, Phase last) {
+    Phase ph;
+    for (ph = first; ph <= last; ph++)
+        if (selected[ph]) return TRUE;
+    return FALSE;
+}
+
+/* Executa todas as fases uma vez sobre o arquivo, guardando o tempo de
+   cada uma em secs e o numero de itens em items. Em memory ficam os
+   bytes ocupados pela arvore de ponteiros e pela compacta. */
+static void benchFile(PmCompiler *pm, const char *fileName, double secs[], long items[],
+                      long memory[]) {
+    long ntokens = 0, nodes;
+    double t0;
+    TreeNode *t;
+    int ph;
+
+    if (selected[F_GETTOKEN]) {
+        openSource(pm, fileName);
+        t0 = now();
+        while (getToken(pm) != ENDFILE)
+            ntokens++;
+        secs[F_GETTOKEN] = now() - t0;
+        fclose(pm->source);
+    }
+    items[F_GETTOKEN] = ntokens;
+    if (!anySelected(F_PARSE, NPHASES - 1))
+        return;
+
+    openSource(pm, fileName);
+    if (!scanAll(pm, &pm->tokens)) exit(1);
+    t0 = now();
+    t = parseTokens(pm);
+    secs[F_PARSE] = now() - t0;
+    visited = 0;
+    walkTree(pm, t, visitNode, NULL);
+    nodes = visited;
+    for (ph = F_PARSE; ph < NPHASES; ph++)
+        items[ph] = nodes;
+    memory[0] = nodes * (long) sizeof(TreeNode);
+    fclose(pm->source);
+    if (pm->error) {
+        fprintf(stderr, "%s: erro de sintaxe, fases seguintes nao medidas\n", fileName);
+        for (ph = F_FLATTEN; ph < NPHASES; ph++)
+            secs[ph] = 0;
+        resetCompiler(pm);
+        return;
+    }
+
+    /* A copia eh feita antes de typeCheck, para que as passadas nas duas
+       arvores partam dos mesmos tipos */
+    if (anySelected(F_FLATTEN, NPHASES - 1)) {
+        t0 = now();
+        if (!flattenTree(pm, t, &ast)) exit(1);
+        secs[F_FLATTEN] = now() - t0;
+        memory[1] = astBytes(&ast);
+    }
+    if (selected[F_MAPAST]) {
+        AstTree mapped;
+        memset(&mapped, 0, sizeof(mapped));
+        if (!astWrite(pm, &ast, BENCH_AST, -1, 0)) exit(1);
+        /* astMap insere de novo os nomes, com os mesmos ids */
+        internClear(pm);
+        t0 = now();
+        if (!astMap(pm, &mapped, BENCH_AST, -1, 0)) exit(1);
+        secs[F_MAPAST] = now() - t0;
+        freeAst(&mapped);
+        remove(BENCH_AST);
+    }
+    if (selected[F_TRAVERSE]) {
+        visited = 0;
+        t0 = now();
+        walkTree(pm, t, visitNode, NULL);
+        secs[F_TRAVERSE] = now() - t0;
+    }
+    if (selected[F_TRAVERSEAST]) {
+        visited = 0;
+        t0 = now();
+        walkAst(pm, &ast, ast.root, visitAstNode, NULL);
+        secs[F_TRAVERSEAST] = now() - t0;
+    }
+
+    /* analyze muda os tipos dos nos como typeCheck; a tabela eh
+       esvaziada para as fases seguintes */
+    if (selected[F_ANALYZE]) {
+        t0 = now();
+        analyze(pm, t);
+        secs[F_ANALYZE] = now() - t0;
+        st_clear(pm);
+        pm->location = 0;
+    }
+
+    /* typeCheck e codeGen usam a tabela de simbolos, entao buildSymtab
+       roda mesmo quando nao eh medida (e typeCheck, antes de codeGen) */
+    if (selected[F_BUILDSYMTAB] || selected[F_TYPECHECK] || selected[F_CODEGEN]) {
+        t0 = now();
+        buildSymtab(pm, t);
+        secs[F_BUILDSYMTAB] = now() - t0;
+    }
+    if (selected[F_TYPECHECK] || selected[F_CODEGEN]) {
+        t0 = now();
+        typeCheck(pm, t);
+        secs[F_TYPECHECK] = now() - t0;
+    }
+    if (selected[F_PRINTTREE]) {
+        t0 = now();
+        printTree(pm, t);
+        fflush(pm->listing);
+        secs[F_PRINTTREE] = now() - t0;
+    }
+    if (selected[F_CODEGEN]) {
+        t0 = now();
+        codeGen(pm, t);
+        secs[F_CODEGEN] = now() - t0;
+    }
+
+    /* As mesmas passadas na arvore compacta, com a tabela de simbolos vazia */
+    st_clear(pm);
+    pm->location = 0;
+    if (selected[F_BUILDSYMTABAST] || selected[F_TYPECHECKAST]) {
+        t0 = now();
+        buildSymtabAst(pm, &ast);
+        secs[F_BUILDSYMTABAST] = now() - t0;
+    }
+    if (selected[F_TYPECHECKAST]) {
+        t0 = now();
+        typeCheckAst(pm, &ast);
+        secs[F_TYPECHECKAST] = now() - t0;
+    }
+    if (selected[F_PRINTTREEAST]) {
+        t0 = now();
+        printAst(pm, &ast);
+        fflush(pm->listing);
+        secs[F_PRINTTREEAST] = now() - t0;
+    }
+
+    /* Edicoes de um caractere espalhadas pelo programa: um espaco eh
+       inserido antes de um comando do nivel mais alto e depois removido.
+       incrOpen nao eh medida. */
+    if (selected[F_REPARSE]) {
+        int e;
+        if (!incrOpen(pm, pm->sourceText, pm->sourceSize)) exit(1);
+        t0 = now();
+        for (e = 0; e < REPARSE_EDITS; e += 2) {
+            long at = pm->spans[(int) (e * 7919L % pm->nspans)].start;
+            incrEdit(pm, at, 0, " ", 1);
+            incrEdit(pm, at, 1, "", 0);
+        }
+        secs[F_REPARSE] = now() - t0;
+        items[F_REPARSE] = REPARSE_EDITS;
+    }
+
+    /* parse e parseParallel desde o fonte recem-aberto, com a varredura */
+    if (selected[F_SCANPARSE]) {
+        openSource(pm, fileName);
+        t0 = now();
+        parse(pm);
+        secs[F_SCANPARSE] = now() - t0;
+        fclose(pm->source);
+    }
+    if (selected[F_PARSEPARALLEL]) {
+        openSource(pm, fileName);
+        t0 = now();
+        parseParallel(pm, parseThreads);
+        secs[F_PARSEPARALLEL] = now() - t0;
+        fclose(pm->source);
+    }
+    resetCompiler(pm);
+}
+
+/* Mede a tabela de simbolos com n variaveis de ids 0..n-1, densos como
+   os da tabela de nomes. Vale o melhor tempo de reps execucoes. */
+static void benchSymtab(PmCompiler *pm, long n, int reps, int csv) {
+    static const char *opName[4] = {"insercao", "citacao", "busca", "ausente"};
+    double best[4], t0;
+    unsigned long long seed = 1;
+    int *order, r, op;
+    long i, found = 0;
+
+    if ((order = (int *) malloc(n * sizeof(int))) == NULL) {
+        fprintf(stderr, "Sem memoria para %ld simbolos\n", n);
+        exit(1);
+    }
+    /* permutacao aleatoria dos ids, para a busca nao seguir a tabela */
+    for (i = 0; i < n; i++)
+        order[i] = (int) i;
+    for (i = n - 1; i > 0; i--) {
+        long j;
+        int tmp;
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        j = (long) ((seed >> 33) % (unsigned long long) (i + 1));
+        tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    }
+    for (r = 0; r < reps; r++) {
+        double secs[4];
+        st_clear(pm);
+        pm->location = 0;
+        t0 = now();
+        for (i = 0; i < n; i++)
+            st_find_or_insert(pm, (int) i, 1, Integer);
+        secs[0] = now() - t0;
+        t0 = now();
+        for (i = 0; i < n; i++)
+            st_find_or_insert(pm, (int) i, 2, Integer);
+        secs[1] = now() - t0;
+        t0 = now();
+        for (i = 0; i < n; i++)
+            found += st_lookup(pm, order[i]) >= 0;
+        secs[2] = now() - t0;
+        t0 = now();
+        for (i = 0; i < n; i++)
+            found += st_lookup(pm, (int) (n + order[i])) >= 0;
+        secs[3] = now() - t0;
+        for (op = 0; op < 4; op++)
+            if (r == 0 || secs[op] < best[op]) best[op] = secs[op];
+    }
+    st_clear(pm);
+    free(order);
+    if (found != (long) reps * n) {
+        fprintf(stderr, "Tabela de simbolos inconsistente com %ld simbolos\n", n);
+        exit(1);
+    }
+    if (csv) {
+        for (op = 0; op < 4; op++)
+            printf("symtab,%s,0,%ld,%.6f,0,%.0f\n", opName[op], n, best[op],
+                   n / (best[op] > 0 ? best[op] : 1e-9));
+        return;
+    }
+    printf("symtab %ld simbolos:", n);
+    for (op = 0; op < 4; op++)
+        printf(" %s %.1f ns%s", opName[op], best[op] / n * 1e9, op < 3 ? "," : "\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-r repeticoes] [-m] [-f fases] [-j threads] [-s simbolos] arquivos...\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 5, csv = FALSE, r, i, ph;
+    PmCompiler *pm;
+
+    for (ph = 0; ph < NPHASES; ph++)
+        selected[ph] = TRUE;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0)
+            csv = TRUE;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            parseThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            char *size;
+            for (size = strtok(argv[++i], ","); size != NULL; size = strtok(NULL, ",")) {
+                if (nsymSizes == MAXSYMSIZES || (symSizes[nsymSizes++] = atol(size)) < 1)
+                    usage(argv[0]);
+            }
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            char *name;
+            for (ph = 0; ph < NPHASES; ph++)
+                selected[ph] = FALSE;
+            for (name = strtok(argv[++i], ","); name != NULL; name = strtok(NULL, ",")) {
+                for (ph = 0; ph < NPHASES && strcmp(name, phaseName[ph]) != 0; ph++)
+                    ;
+                if (ph == NPHASES) {
+                    fprintf(stderr, "Fase desconhecida: %s\n", name);
+                    usage(argv[0]);
+                }
+                selected[ph] = TRUE;
+            }
+        } else
+            usage(argv[0]);
+    }
+    if (i == argc && nsymSizes == 0) usage(argv[0]);
+    if (reps < 1) reps = 1;
+
+    if ((pm = newCompiler()) == NULL) return 1;
+    /* a listagem (tabela de simbolos, arvore, erros) nao interessa aqui */
+    if ((pm->listing = fopen(NULL_FILE, "w")) == NULL) {
+        perror(NULL_FILE);
+        return 1;
+    }
+    if (csv)
+        printf("arquivo,fase,bytes,itens,segundos,mb_s,itens_s\n");
+
+    for (r = 0; r < nsymSizes; r++)
+        benchSymtab(pm, symSizes[r], reps, csv);
+
+    for (; i < argc; i++) {
+        double best[NPHASES], secs[NPHASES];
+        long items[NPHASES] = {0}, memory[2] = {0}, bytes;
+        FILE *f;
+
+        if ((f = fopen(argv[i], "rb")) == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        bytes = ftell(f);
+        fclose(f);
+
+        /* a melhor de reps execucoes de cada fase */
+        for (r = 0; r < reps; r++) {
+            for (ph = 0; ph < NPHASES; ph++) secs[ph] = 0;
+            benchFile(pm, argv[i], secs, items, memory);
+            for (ph = 0; ph < NPHASES; ph++)
+                if (r == 0 || secs[ph] < best[ph]) best[ph] = secs[ph];
+        }
+
+        if (!csv)
+            printf("%s: %.1f MB, %ld tokens, %ld nos (arvore %.1f MB, compacta %.1f MB)\n",
+                   argv[i], bytes / 1e6, items[F_GETTOKEN], items[F_PARSE],
+                   memory[0] / 1e6, memory[1] / 1e6);
+        for (ph = 0; ph < NPHASES; ph++) {
+            double s = best[ph] > 0 ? best[ph] : 1e-9;
+            if (!selected[ph]) continue;
+            if (csv)
+                printf("%s,%s,%ld,%ld,%.6f,%.2f,%.0f\n", argv[i], phaseName[ph],
+                       bytes, items[ph], best[ph], bytes / s / 1e6, items[ph] / s);
+            else if (ph == F_REPARSE)
+                printf("  %-14s %9.4f s %10.1f us/edicao %7.0f edicoes/s\n", phaseName[ph],
+                       best[ph], best[ph] / items[ph] * 1e6, items[ph] / s);
+            else
+                printf("  %-14s %9.4f s %10.1f MB/s %12.2f M%s/s\n", phaseName[ph],
+                       best[ph], bytes / s / 1e6, items[ph] / s / 1e6,
+                       ph == F_GETTOKEN ? "tokens" : "nos");
+        }
+    }
+
+    fclose(pm->listing);
+    freeAst(&ast);
+    freeCompiler(pm);
+    return 0;
+}
@@ -0,0 +1,451 @@
+/****************************************************/
+/* File: cgen.c                                     */
+/* Code generator for the P- compiler               */
+/* (register bytecode, code.h)                      */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "intern.h"
+#include "code.h"
+#include "cgen.h"
+#include "compiler.h"
+
+/* Operacao de cada operador binario com operandos inteiros e com
+   operandos reais. E e OU so tem a versao inteira: os operandos reais
+   sao antes trocados por 0 ou 1 (OP_TESTR). */
+static const unsigned char intOp[ERROR + 1] = {
+  [MAIS] = OP_ADDI, [MENOS] = OP_SUBI, [VEZES] = OP_MULI, [SOBRE] = OP_DIVI,
+  [MENOR_QUE] = OP_LTI, [MENOR_QUE_IGUAL] = OP_LEI,
+  [MAIOR_QUE] = OP_GTI, [MAIOR_QUE_IGUAL] = OP_GEI,
+  [IGUAL] = OP_EQI, [NAO_IGUAL] = OP_NEI,
+  [E] = OP_AND, [OU] = OP_OR
+};
+static const unsigned char realOp[ERROR + 1] = {
+  [MAIS] = OP_ADDR, [MENOS] = OP_SUBR, [VEZES] = OP_MULR, [SOBRE] = OP_DIVR,
+  [MENOR_QUE] = OP_LTR, [MENOR_QUE_IGUAL] = OP_LER,
+  [MAIOR_QUE] = OP_GTR, [MAIOR_QUE_IGUAL] = OP_GER,
+  [IGUAL] = OP_EQR, [NAO_IGUAL] = OP_NER
+};
+
+/* Mostra o erro de geracao, se for o primeiro, e marca pm->error */
+static void codeError(PmCompiler * pm, int lineno, const char * message) {
+  if (!pm->error)
+    fprintf(pm->listing,"Code error at line %d: %s\n",lineno,message);
+  pm->error = TRUE;
+}
+
+/* Garante espaco para mais um item de size bytes no array *items, que
+   tem count itens e capacidade *capacity. Retorna FALSE se faltar
+   memoria. */
+static int reserveItem(PmCompiler * pm, void ** items, int count, int * capacity, size_t size) {
+  void * grown;
+  int cap;
+  if (count < *capacity)
+    return TRUE;
+  cap = *capacity ? 2 * *capacity : 256;
+  if ((grown = realloc(*items, cap * size)) == NULL) {
+    if (!pm->error)
+      fprintf(pm->listing,"Out of memory error generating code\n");
+    pm->error = TRUE;
+    return FALSE;
+  }
+  *items = grown;
+  *capacity = cap;
+  return TRUE;
+}
+
+/* Acrescenta uma palavra ao codigo e retorna a sua posicao */
+static int emitRaw(PmCompiler * pm, unsigned int word) {
+  CodeModule * m = &pm->module;
+  if (pm->error ||
+      !reserveItem(pm, (void **) &m->code, m->ncode, &m->codeCapacity, sizeof(unsigned int)))
+    return m->ncode;
+  m->code[m->ncode] = word;
+  return m->ncode++;
+}
+
+/* Acrescenta uma instrucao gerada para a linha lineno */
+static void emit(PmCompiler * pm, unsigned int word, int lineno) {
+  CodeModule * m = &pm->module;
+  if (!pm->error && (m->nlines == 0 || m->lines[m->nlines-1].lineno != lineno) &&
+      reserveItem(pm, (void **) &m->lines, m->nlines, &m->linesCapacity, sizeof(CodeLine))) {
+    m->lines[m->nlines].pc = m->ncode;
+    m->lines[m->nlines].lineno = lineno;
+    m->nlines++;
+  }
+  emitRaw(pm, word);
+}
+
+/* Acrescenta uma instrucao com a palavra w e retorna a posicao de w,
+   para que um desvio possa ser completado depois (patch) */
+static int emitWide(PmCompiler * pm, OpCode op, int a, unsigned int w, int lineno) {
+  emit(pm, CODE_WORD(op,a,0,0), lineno);
+  return emitRaw(pm, w);
+}
+
+/* Completa o desvio cuja palavra w esta em at */
+static void patch(PmCompiler * pm, int at, int target) {
+  if (!pm->error)
+    pm->module.code[at] = (unsigned int) target;
+}
+
+/* Posicao corrente do codigo, destino dos desvios */
+#define HERE(pm) ((pm)->module.ncode)
+
+/* Registro da variavel citada em t, ou NULL se ela faltar na tabela de
+   simbolos (so quando a construcao da tabela ficou sem memoria) */
+static BucketList variable(PmCompiler * pm, TreeNode * t) {
+  if (t->sym < 0) {
+    codeError(pm, t->lineno, "variable missing from symbol table");
+    return NULL;
+  }
+  return &pm->symbols[t->sym];
+}
+
+/* Tipo de uma variavel: o da declaracao, ou inteiro para as variaveis
+   nao declaradas */
+static ExpType varType(BucketList v) {
+  return (v != NULL && v->type == Real) ? Real : Integer;
+}
+
+/* Converte o valor de r<reg> do tipo from para o tipo to */
+static void convert(PmCompiler * pm, int reg, ExpType from, ExpType to, int lineno) {
+  if (from == Integer && to == Real)
+    emit(pm, CODE_WORD(OP_ITOR,reg,reg,0), lineno);
+  else if (from == Real && to == Integer)
+    emit(pm, CODE_WORD(OP_RTOI,reg,reg,0), lineno);
+}
+
+/* Quantidade de operadores da espinha esquerda de uma expressao
+   guardados na pilha nativa; alem disso a espinha vai para o heap */
+#define SPINE_LOCAL 64
+
+/* Gera a folha t (constante ou variavel) em r<reg> e retorna o seu tipo */
+static ExpType genLeaf(PmCompiler * pm, TreeNode * t, int reg) {
+  CodeModule * m = &pm->module;
+  BucketList v;
+  switch (t->kind.exp) {
+    case ConstK:
+      if (t->type != Real && t->attr.val.vint >= -32768 && t->attr.val.vint <= 32767) {
+        emit(pm, CODE_WORDX(OP_LOADI,reg,t->attr.val.vint), t->lineno);
+        return Integer;
+      }
+      if (!reserveItem(pm, (void **) &m->consts, m->nconsts, &m->constsCapacity, sizeof(NumValue)))
+        return Integer;
+      m->consts[m->nconsts] = t->attr.val;
+      emitWide(pm, t->type == Real ? OP_LOADKR : OP_LOADKI, reg, m->nconsts++, t->lineno);
+      return t->type == Real ? Real : Integer;
+    case IdK:
+      if ((v = variable(pm, t)) != NULL)
+        emitWide(pm, OP_GET, reg, v->memloc, t->lineno);
+      return varType(v);
+    default:
+      return Integer;
+  }
+}
+
+/* Gera o operador t sobre r<reg> (operando esquerdo, do tipo lt) e
+   r<reg+1> (direito, do tipo rt), deixando o resultado em r<reg>, e
+   retorna o tipo do resultado */
+static ExpType genOp(PmCompiler * pm, TreeNode * t, int reg, ExpType lt, ExpType rt) {
+  TokenType op = t->attr.op;
+  if (op == E || op == OU) {
+    if (lt == Real)
+      emit(pm, CODE_WORD(OP_TESTR,reg,reg,0), t->lineno);
+    if (rt == Real)
+      emit(pm, CODE_WORD(OP_TESTR,reg+1,reg+1,0), t->lineno);
+    emit(pm, CODE_WORD(intOp[op],reg,reg,reg+1), t->lineno);
+    return Integer;
+  }
+  if (lt == Real || rt == Real) {
+    convert(pm, reg, lt, Real, t->lineno);
+    convert(pm, reg + 1, rt, Real, t->lineno);
+    emit(pm, CODE_WORD(realOp[op],reg,reg,reg+1), t->lineno);
+    return realOp[op] <= OP_DIVR ? Real : Integer;
+  }
+  emit(pm, CODE_WORD(intOp[op],reg,reg,reg+1), t->lineno);
+  return Integer;
+}
+
+/* Gera o codigo que deixa o valor da expressao t em r<reg>, usando os
+   registradores a partir de reg para os valores intermediarios, e
+   retorna o tipo do valor, Integer ou Real. typeCheck so distingue os
+   testes booleanos dos valores numericos, entao os tipos sao apurados
+   aqui: o de uma variavel eh o da tabela de simbolos, o de uma constante
+   eh o dado pela varredura, um operador aritmetico eh real se algum
+   operando for real e os relacionais e logicos dao inteiro (0 ou 1).
+   O operando esquerdo fica no mesmo registrador que o operador, entao a
+   espinha esquerda (a - b - c - ...) eh gerada num laco, de baixo para
+   cima; so o operando direito usa recursao, e cada nivel dela ocupa mais
+   um registrador, o que a limita a CODE_MAXREGS niveis. */
+static ExpType genExp(PmCompiler * pm, TreeNode * t, int reg) {
+  TreeNode * local[SPINE_LOCAL], ** spine = local, * n;
+  ExpType type, rt;
+  int count = 0, i;
+  if (t == NULL || pm->error)
+    return Integer;
+  if (reg >= CODE_MAXREGS) {
+    codeError(pm, t->lineno, "expression too complex");
+    return Integer;
+  }
+  if (reg >= pm->module.nregs)
+    pm->module.nregs = reg + 1;
+  for (n = t; n != NULL && n->kind.exp == OpK; n = n->child[0])
+    count++;
+  if (count > SPINE_LOCAL &&
+      (spine = (TreeNode **) malloc(count * sizeof(TreeNode *))) == NULL) {
+    if (!pm->error)
+      fprintf(pm->listing,"Out of memory error generating code\n");
+    pm->error = TRUE;
+    return Integer;
+  }
+  for (i = 0, n = t; i < count; i++, n = n->child[0])
+    spine[i] = n;
+  type = (n == NULL) ? Integer : genLeaf(pm, n, reg);
+  for (i = count - 1; i >= 0 && !pm->error; i--) {
+    rt = genExp(pm, spine[i]->child[1], reg + 1);
+    type = genOp(pm, spine[i], reg, type, rt);
+  }
+  if (spine != local)
+    free(spine);
+  return type;
+}
+
+/* Gera o teste t em r0 como um inteiro, zero para falso */
+static void genTest(PmCompiler * pm, TreeNode * t, int lineno) {
+  if (genExp(pm, t, 0) == Real)
+    emit(pm, CODE_WORD(OP_TESTR,0,0,0), lineno);
+}
+
+/* Comando composto (se, enquanto, repita) cuja lista interna esta sendo
+   gerada: stage eh a lista corrente (1 para entao, 2 para senao), jump a
+   posicao do desvio a completar e body o inicio do corpo do laco */
+typedef struct {
+  TreeNode * node;
+  int stage, jump, body;
+} GenFrame;
+
+/* Gera o codigo da sequencia de comandos que comeca em t. Os lacos
+   testam a condicao no fim, com um unico desvio por volta. Nao usa
+   recursao: ao entrar num bloco o comando composto vai para uma pilha
+   explicita, e o seu codigo eh completado quando a lista interna acaba. */
+static void genStmt(PmCompiler * pm, TreeNode * t) {
+  GenFrame * stack = NULL, * f;
+  int sp = 0, capacity = 0, skip;
+  BucketList v;
+  while (!pm->error) {
+    if (t == NULL) { /* fim de uma lista: completa o comando composto */
+      if (sp == 0)
+        break;
+      f = &stack[sp-1];
+      switch (f->node->kind.stmt) {
+        case IfK:
+          if (f->stage == 1 && f->node->child[2] != NULL) {
+            skip = emitWide(pm, OP_JMP, 0, 0, f->node->lineno);
+            patch(pm, f->jump, HERE(pm));
+            f->jump = skip;
+            f->stage = 2;
+            t = f->node->child[2];
+            continue;
+          }
+          patch(pm, f->jump, HERE(pm));
+          break;
+        case WhileK:
+          patch(pm, f->jump, HERE(pm));
+          genTest(pm, f->node->child[0], f->node->lineno);
+          emitWide(pm, OP_JNZ, 0, f->body, f->node->lineno);
+          break;
+        default: /* RepeatK */
+          genTest(pm, f->node->child[1], f->node->lineno);
+          emitWide(pm, OP_JZ, 0, f->body, f->node->lineno);
+          break;
+      }
+      t = f->node->sibling;
+      sp--;
+      continue;
+    }
+    if (t->nodekind != StmtK) {
+      t = t->sibling;
+      continue;
+    }
+    switch (t->kind.stmt) {
+      case AssignK:
+        if ((v = variable(pm, t)) == NULL)
+          break;
+        convert(pm, 0, genExp(pm, t->child[0], 0), varType(v), t->lineno);
+        emitWide(pm, OP_PUT, 0, v->memloc, t->lineno);
+        break;
+      case ReadK:
+        if ((v = variable(pm, t)) != NULL)
+          emitWide(pm, varType(v) == Real ? OP_READR : OP_READI, 0, v->memloc, t->lineno);
+        break;
+      case WriteK:
+        emit(pm, CODE_WORD(genExp(pm, t->child[0], 0) == Real ? OP_WRITER : OP_WRITEI,0,0,0),
+             t->lineno);
+        break;
+      case IfK: /* teste; JZ senao; entao; JMP fim; senao: ...; fim: */
+      case WhileK: /* JMP teste; corpo: ...; teste: ...; JNZ corpo */
+      case RepeatK: /* corpo: ...; teste; JZ corpo */
+        if (!reserveItem(pm, (void **) &stack, sp, &capacity, sizeof(GenFrame)))
+          break;
+        f = &stack[sp++];
+        f->node = t;
+        f->stage = 1;
+        f->jump = f->body = 0;
+        if (t->kind.stmt == IfK) {
+          genTest(pm, t->child[0], t->lineno);
+          f->jump = emitWide(pm, OP_JZ, 0, 0, t->lineno);
+          t = t->child[1];
+        } else if (t->kind.stmt == WhileK) {
+          f->jump = emitWide(pm, OP_JMP, 0, 0, t->lineno);
+          f->body = HERE(pm);
+          t = t->child[1];
+        } else {
+          f->body = HERE(pm);
+          t = t->child[0];
+        }
+        continue;
+      default: /* DeclK: as variaveis comecam com zero */
+        break;
+    }
+    t = t->sibling;
+  }
+  free(stack);
+}
+
+/* Grava o modulo no arquivo f */
+static int writeCode(FILE * f, const CodeModule * m) {
+  CodeFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CODE_MAGIC, sizeof(h.magic));
+  h.version = CODE_VERSION;
+  h.byteOrder = CODE_BYTE_ORDER;
+  h.headerSize = sizeof(h);
+  h.constSize = sizeof(NumValue);
+  h.nslots = m->nslots;
+  h.nregs = m->nregs;
+  h.ncode = m->ncode;
+  h.nconsts = m->nconsts;
+  h.nlines = m->nlines;
+  return fwrite(&h, sizeof(h), 1, f) == 1 &&
+         (m->nconsts == 0 || fwrite(m->consts, sizeof(NumValue), m->nconsts, f) == (size_t) m->nconsts) &&
+         fwrite(m->code, sizeof(unsigned int), m->ncode, f) == (size_t) m->ncode &&
+         fwrite(m->lines, sizeof(CodeLine), m->nlines, f) == (size_t) m->nlines &&
+         fflush(f) == 0;
+}
+
+/* Gera o codigo da arvore sintatica */
+int codeGen(PmCompiler * pm, TreeNode * syntaxTree) {
+  CodeModule * m = &pm->module;
+  m->ncode = m->nconsts = m->nlines = m->nregs = 0;
+  m->nslots = pm->location;
+  genStmt(pm, syntaxTree);
+  emit(pm, CODE_WORD(OP_HALT,0,0,0), pm->lineno);
+  if (pm->error)
+    return FALSE;
+  if (TraceCode) {
+    fprintf(pm->listing,"\nBytecode:\n\n");
+    printCode(pm, m);
+  }
+  if (pm->code != NULL && !writeCode(pm->code, m)) {
+    fprintf(pm->listing,"Error writing code file\n");
+    pm->error = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Nome de cada operacao na listagem */
+static const char * const opName[OP_COUNT] = {
+  [OP_HALT] = "halt", [OP_LOADI] = "loadi", [OP_ITOR] = "itor", [OP_RTOI] = "rtoi",
+  [OP_ADDI] = "addi", [OP_SUBI] = "subi", [OP_MULI] = "muli", [OP_DIVI] = "divi",
+  [OP_ADDR] = "addr", [OP_SUBR] = "subr", [OP_MULR] = "mulr", [OP_DIVR] = "divr",
+  [OP_LTI] = "lti", [OP_LEI] = "lei", [OP_GTI] = "gti", [OP_GEI] = "gei",
+  [OP_EQI] = "eqi", [OP_NEI] = "nei",
+  [OP_LTR] = "ltr", [OP_LER] = "ler", [OP_GTR] = "gtr", [OP_GER] = "ger",
+  [OP_EQR] = "eqr", [OP_NER] = "ner",
+  [OP_TESTR] = "testr", [OP_AND] = "and", [OP_OR] = "or",
+  [OP_WRITEI] = "writei", [OP_WRITER] = "writer",
+  [OP_LOADKI] = "loadki", [OP_LOADKR] = "loadkr", [OP_GET] = "get", [OP_PUT] = "put",
+  [OP_JMP] = "jmp", [OP_JZ] = "jz", [OP_JNZ] = "jnz",
+  [OP_READI] = "readi", [OP_READR] = "readr"
+};
+
+/* Mostra o modulo na listagem. Antes das instrucoes de cada linha do
+   fonte vem "* linha N"; os acessos a memoria levam o nome da variavel
+   (se ela estiver na tabela de simbolos de pm) e as constantes, o
+   valor. */
+void printCode(PmCompiler * pm, const CodeModule * m) {
+  char text[160];
+  int * names = NULL, pc, line = 0, n, i;
+  if (m->nslots > 0 && (names = (int *) malloc(m->nslots * sizeof(int))) != NULL) {
+    for (i = 0; i < m->nslots; i++)
+      names[i] = -1;
+    for (i = 0; i < pm->symCount; i++)
+      if (pm->symbols[i].memloc >= 0 && pm->symbols[i].memloc < m->nslots)
+        names[pm->symbols[i].memloc] = pm->symbols[i].id;
+  }
+  for (pc = 0; pc < m->ncode; pc += CODE_WIDE(CODE_OP(m->code[pc])) ? 2 : 1) {
+    unsigned int word = m->code[pc], w = 0;
+    OpCode op = CODE_OP(word);
+    const char * name = (op < OP_COUNT) ? opName[op] : "???";
+    int a = CODE_A(word);
+    if (CODE_WIDE(op)) {
+      if (pc + 1 >= m->ncode)
+        break;
+      w = m->code[pc+1];
+    }
+    for (; line < m->nlines && m->lines[line].pc <= pc; line++) {
+      n = snprintf(text, sizeof(text), "* linha %d\n", m->lines[line].lineno);
+      outText(pm, text, n);
+    }
+    switch (op) {
+      case OP_HALT:
+        n = snprintf(text, sizeof(text), "%6d  %s", pc, name);
+        break;
+      case OP_LOADI:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d, %d", pc, name, a, CODE_SBX(word));
+        break;
+      case OP_ITOR: case OP_RTOI: case OP_TESTR:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d, r%d", pc, name, a, (int) CODE_B(word));
+        break;
+      case OP_WRITEI: case OP_WRITER:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d", pc, name, a);
+        break;
+      case OP_LOADKI: case OP_LOADKR:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d, k%u", pc, name, a, w);
+        if (w < (unsigned int) m->nconsts) {
+          if (op == OP_LOADKR)
+            n += snprintf(text + n, sizeof(text) - n, "\t%f", m->consts[w].vreal);
+          else
+            n += snprintf(text + n, sizeof(text) - n, "\t%lld", m->consts[w].vint);
+        }
+        break;
+      case OP_GET: case OP_PUT: case OP_READI: case OP_READR:
+        if (op == OP_READI || op == OP_READR)
+          n = snprintf(text, sizeof(text), "%6d  %-7s m%u", pc, name, w);
+        else
+          n = snprintf(text, sizeof(text), "%6d  %-7s r%d, m%u", pc, name, a, w);
+        if (names != NULL && w < (unsigned int) m->nslots && names[w] >= 0)
+          n += snprintf(text + n, sizeof(text) - n, "\t%.40s", internString(pm, names[w]));
+        break;
+      case OP_JMP:
+        n = snprintf(text, sizeof(text), "%6d  %-7s %u", pc, name, w);
+        break;
+      case OP_JZ: case OP_JNZ:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d, %u", pc, name, a, w);
+        break;
+      default:
+        n = snprintf(text, sizeof(text), "%6d  %-7s r%d, r%d, r%d", pc, name, a,
+                     (int) CODE_B(word), (int) CODE_C(word));
+        break;
+    }
+    if (n >= (int) sizeof(text))
+      n = (int) sizeof(text) - 1;
+    outText(pm, text, n);
+    outText(pm, "\n", 1);
+  }
+  free(names);
+  outFlush(pm);
+}
@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: cgen.h                                     */
+/* Code generator interface for the P- compiler     */
+/****************************************************/
+
+#ifndef _CGEN_H_
+#define _CGEN_H_
+
+/* Traduz a arvore sintatica, ja analisada por buildSymtab e typeCheck
+   sem erros, para o bytecode de code.h em pm->module. Se pm->code nao
+   for NULL, grava o modulo nele; com TraceCode, mostra o codigo
+   comentado na listagem. Retorna FALSE (e marca pm->error) se uma
+   expressao precisar de mais de CODE_MAXREGS registradores, se faltar
+   memoria ou se a gravacao falhar. */
+int codeGen(PmCompiler *, TreeNode *);
+
+/* Mostra o modulo na listagem, uma instrucao por linha */
+void printCode(PmCompiler *, const CodeModule *);
+
+#endif
@@ -0,0 +1,97 @@
+/****************************************************/
+/* File: code.h                                     */
+/* Register bytecode for the P- compiler            */
+/****************************************************/
+
+#ifndef _CODE_H_
+#define _CODE_H_
+
+/* Bytecode de uma maquina de registradores. As variaveis ficam na
+   memoria M, uma posicao por localizacao de memoria da tabela de
+   simbolos (memloc); os valores intermediarios das expressoes ficam nos
+   registradores r0..r255. Cada posicao de M e cada registrador guarda
+   um NumValue, inteiro ou real conforme a instrucao que o usa: os tipos
+   sao resolvidos na geracao, e cada operacao tem uma versao inteira
+   (sufixo I) e uma real (sufixo R).
+   Uma instrucao ocupa uma palavra de 32 bits: o codigo da operacao no
+   byte baixo e os operandos A, B e C nos seguintes, ou A e um inteiro
+   com sinal sBx nos 16 bits altos. As operacoes de OP_LOADKI a OP_READR
+   levam ainda uma segunda palavra, w, com o indice da constante, a
+   posicao de memoria ou o destino do desvio (em palavras). */
+
+#define CODE_MAXREGS 256
+
+typedef enum {
+  OP_HALT,                         /* fim do programa */
+  OP_LOADI,                        /* rA = sBx */
+  OP_ITOR,                         /* rA = (real) rB */
+  OP_RTOI,                         /* rA = (inteiro) rB, truncado */
+  OP_ADDI, OP_SUBI, OP_MULI, OP_DIVI, /* rA = rB op rC */
+  OP_ADDR, OP_SUBR, OP_MULR, OP_DIVR,
+  OP_LTI, OP_LEI, OP_GTI, OP_GEI, OP_EQI, OP_NEI, /* rA = rB op rC ? 1 : 0 */
+  OP_LTR, OP_LER, OP_GTR, OP_GER, OP_EQR, OP_NER,
+  OP_TESTR,                        /* rA = rB != 0.0 */
+  OP_AND, OP_OR,                   /* rA = (rB != 0) op (rC != 0) */
+  OP_WRITEI, OP_WRITER,            /* mostra rA */
+  /* com a palavra w */
+  OP_LOADKI, OP_LOADKR,            /* rA = K[w]; o tipo so serve para
+                                      mostrar o valor (printCode) */
+  OP_GET,                          /* rA = M[w] */
+  OP_PUT,                          /* M[w] = rA */
+  OP_JMP,                          /* desvia para w */
+  OP_JZ, OP_JNZ,                   /* desvia para w se rA == 0 (!= 0) */
+  OP_READI, OP_READR,              /* le M[w] */
+  OP_COUNT
+} OpCode;
+
+#define CODE_WIDE(op) ((op) >= OP_LOADKI && (op) <= OP_READR)
+
+#define CODE_WORD(op,a,b,c) \
+  ((unsigned int) (op) | (unsigned int) (a) << 8 | (unsigned int) (b) << 16 | (unsigned int) (c) << 24)
+#define CODE_WORDX(op,a,sbx) \
+  ((unsigned int) (op) | (unsigned int) (a) << 8 | ((unsigned int) (sbx) & 0xffff) << 16)
+#define CODE_OP(w) ((OpCode) ((w) & 0xff))
+#define CODE_A(w) (((w) >> 8) & 0xff)
+#define CODE_B(w) (((w) >> 16) & 0xff)
+#define CODE_C(w) ((w) >> 24)
+#define CODE_SBX(w) ((int) ((w) >> 16 ^ 0x8000) - 0x8000)
+
+/* Primeira instrucao gerada para a linha lineno do fonte */
+typedef struct {
+  int pc;
+  int lineno;
+} CodeLine;
+
+/* Programa gerado: ncode palavras de instrucao, as constantes usadas por
+   OP_LOADKI e OP_LOADKR e a tabela de linhas, em ordem de pc. nslots eh
+   o tamanho de M e nregs a quantidade de registradores usados. */
+typedef struct {
+  unsigned int *code;
+  int ncode, codeCapacity;
+  NumValue *consts;
+  int nconsts, constsCapacity;
+  CodeLine *lines;
+  int nlines, linesCapacity;
+  int nslots, nregs;
+} CodeModule;
+
+/* Arquivo de codigo: o cabecalho, seguido das constantes, das palavras
+   de instrucao e da tabela de linhas, na representacao da memoria de
+   quem gravou */
+
+#define CODE_MAGIC "PMCODE\n" /* 8 bytes, com o '\0' */
+#define CODE_VERSION 1
+#define CODE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[8];
+  unsigned int version;
+  unsigned int byteOrder; /* CODE_BYTE_ORDER na ordem de quem gravou */
+  unsigned int headerSize; /* sizeof(CodeFileHeader) */
+  unsigned int constSize; /* sizeof(NumValue) */
+  int nslots, nregs;
+  int ncode, nconsts, nlines;
+  int reserved;
+} CodeFileHeader;
+
+#endif
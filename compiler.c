@@ -0,0 +1,74 @@
+/****************************************************/
+/* File: compiler.c                                 */
+/* Compilation context for the P- compiler          */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "intern.h"
+#include "compiler.h"
+
+/* Cria um contexto vazio */
+PmCompiler * newCompiler(void) {
+  PmCompiler * pm = (PmCompiler *) calloc(1, sizeof(PmCompiler));
+  if (pm != NULL && (pm->outBuf = (char *) malloc(OUT_BUFFER)) == NULL) {
+    free(pm);
+    pm = NULL;
+  }
+  if (pm == NULL)
+    fprintf(stderr,"Out of memory error creating compiler\n");
+  return pm;
+}
+
+/* Descarta o estado da compilacao anterior */
+void resetCompiler(PmCompiler * pm) {
+  int i;
+  for (i = 0; i < pm->nparsers; i++)
+    resetCompiler(pm->parsers[i]);
+  scanClose(pm);
+  st_clear(pm);
+  internClear(pm);
+  arenaReset(pm);
+  pm->tokens.count = 0;
+  pm->token = ENDFILE;
+  pm->pos = 0;
+  pm->lineno = 0;
+  pm->error = FALSE;
+  pm->location = 0;
+  pm->nTypeErrors = 0;
+  pm->textCapacity = 0;
+  pm->nspans = 0;
+  pm->syntaxErrors = 0;
+  pm->incrRoot = NULL;
+  pm->ntouched = 0;
+  pm->indentno = 0;
+  pm->outLen = 0;
+  pm->module.ncode = pm->module.nconsts = pm->module.nlines = 0;
+}
+
+/* Libera o contexto */
+void freeCompiler(PmCompiler * pm) {
+  int i;
+  if (pm == NULL) return;
+  resetCompiler(pm);
+  freeTokens(&pm->tokens);
+  internFree(pm);
+  st_free(pm);
+  arenaFree(pm);
+  free(pm->typeErrors);
+  free(pm->spans);
+  free(pm->fresh);
+  free(pm->touched);
+  free(pm->idMark);
+  free(pm->outBuf);
+  free(pm->module.code);
+  free(pm->module.consts);
+  free(pm->module.lines);
+  for (i = 0; i < pm->nparsers; i++)
+    freeCompiler(pm->parsers[i]);
+  free(pm->parsers);
+  free(pm->idMap);
+  if (pm->quiet != NULL)
+    fclose(pm->quiet);
+  free(pm);
+}
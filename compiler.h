@@ -0,0 +1,145 @@
+/****************************************************/
+/* File: compiler.h                                 */
+/* Compilation context for the P- compiler          */
+/****************************************************/
+
+#ifndef _COMPILER_H_
+#define _COMPILER_H_
+
+#include "scan.h"
+#include "symtab.h"
+#include "code.h"
+
+/* Posicao da tabela de nomes: o hash e o tamanho ficam junto do id
+   para que a sondagem so leia o nome quando os dois coincidem */
+typedef struct {
+  unsigned hash;
+  int length;
+  int id; /* id + 1, 0 = posicao vazia */
+} InternSlot;
+
+/* Erro de tipo guardado durante o percurso, impresso no fim da passada */
+typedef struct {
+  int lineno;
+  const char *message;
+} TypeErrorRec;
+
+/* Comando do nivel mais alto do programa, na reanalise incremental: o
+   passo de parseTopStatement (o comando e o ';' seguinte) que comeca no
+   token de deslocamento start, na linha line, e termina num token da
+   linha lastLine */
+typedef struct {
+  unsigned int start;
+  int line, lastLine;
+  TreeNode *stmt; /* comando montado, ou NULL */
+  int error; /* TRUE se houve erro sintatico no passo */
+} StmtSpan;
+
+/* Todo o estado de uma compilacao. Nenhuma fase guarda estado em
+   variaveis globais, entao cada thread pode usar o seu PmCompiler e o
+   mesmo contexto pode ser reutilizado, via resetCompiler, para compilar
+   varios programas em sequencia. */
+struct PmCompiler {
+  FILE *source; /* arquivo de codigo fonte */
+  FILE *listing; /* arquivo com texto de saida */
+  FILE *code; /* arquivo de codigo para a maquina alvo */
+  int lineno; /* numero da linha do codigo fonte */
+  int error; /* TRUE previne passadas futuras se ocorrer um erro */
+
+  /* Varredura (scan.c) */
+  const char *sourceText; /* arquivo fonte inteiro na memoria */
+  long sourceSize;
+  const char *cur; /* proximo caractere a ser lido */
+  const char *end; /* fim do texto fonte */
+  int mapped; /* TRUE se sourceText veio de mmap, FALSE se de malloc */
+  int streaming; /* TRUE se a entrada eh lida em blocos (pipes, stdin) */
+  int streamFd;
+  int streamEof;
+  char *ring; /* buffer circular com os blocos lidos */
+  long ringSize;
+  char *pool; /* lexemas copiados no modo de fluxo; eh o sourceText */
+  long poolSize, poolCapacity;
+  long tokenOffset; /* lexema do token corrente como fatia de sourceText */
+  int tokenLength;
+  NumValue tokenValue; /* valor do token corrente, se for um numero */
+
+  /* Analise sintatica (parse.c) */
+  TokenType token; /* token corrente */
+  TokenBuffer tokens; /* fluxo de tokens produzido por scanAll */
+  int pos; /* indice do token corrente em tokens */
+
+  /* Tabela de nomes (intern.c) */
+  InternSlot *internSlots; /* posicoes da tabela hash */
+  unsigned internMask; /* quantidade de posicoes - 1 */
+  const char **names; /* nome de cada id, copiado na arena */
+  int nameCount, nameCapacity;
+
+  /* Tabela de simbolos (symtab.c) */
+  SymSlot *symSlots; /* posicoes da tabela hash */
+  unsigned symMask; /* quantidade de posicoes - 1 */
+  int symShift; /* 32 - log2 da quantidade de posicoes */
+  int symUsed; /* posicoes ocupadas */
+  BucketList symbols; /* registros das variaveis, indexados pelo simbolo */
+  int symCount; /* variaveis ja inseridas; define a ordem da listagem */
+  int symCapacity;
+
+  /* Analise semantica (analyze.c) */
+  int location; /* proxima localizacao de memoria livre */
+  TypeErrorRec *typeErrors; /* erros de tipo ainda nao impressos */
+  int nTypeErrors, typeErrorsCapacity;
+
+  /* Reanalise incremental (incr.c). sourceText eh um buffer de
+     textCapacity bytes, alterado a cada edicao. */
+  long textCapacity;
+  StmtSpan *spans; /* comandos do nivel mais alto, na ordem do fonte */
+  int nspans, spansCapacity;
+  StmtSpan *fresh; /* comandos reanalisados na edicao corrente */
+  int nfresh, freshCapacity;
+  unsigned int stopOffset; /* token em que a sequencia de comandos parou */
+  int syntaxErrors; /* comandos com erro sintatico */
+  TreeNode *incrRoot; /* primeiro comando da arvore */
+  int *touched; /* nomes cujas citacoes na tabela de simbolos mudaram */
+  int ntouched, touchedCapacity;
+  unsigned char *idMark; /* TRUE para os ids que estao em touched */
+  int idMarkSize;
+  int lineShift; /* linhas a somar nos nos (shiftNode, remapNode) */
+  FILE *quiet; /* listagem descartada das tentativas de reanalise */
+
+  /* Analise sintatica paralela (pparse.c) */
+  struct PmCompiler **parsers; /* contextos dos pedacos do fonte */
+  int nparsers;
+  int *idMap; /* id na tabela principal de cada nome deste contexto */
+  int idMapCapacity;
+
+  /* Geracao de codigo (cgen.c) */
+  CodeModule module; /* codigo gerado pela ultima compilacao */
+
+  /* Impressao da arvore (util.c) */
+  int indentno; /* quantidade de espacos a indentar */
+
+  /* Saida da listagem (util.c) */
+  char *outBuf; /* texto ainda nao entregue a listing */
+  int outLen;
+
+  /* Arena dos nos da arvore e dos lexemas (util.c) */
+  struct ArenaBlock *arenaFirst; /* todos os blocos, reusados a cada compilacao */
+  struct ArenaBlock *arenaCur; /* bloco em uso */
+  char *arenaNext, *arenaEnd; /* parte livre do bloco em uso */
+};
+
+/* Cria um contexto vazio. Os arquivos source, listing e code sao
+   preenchidos por quem chama. Retorna NULL se faltar memoria. */
+PmCompiler * newCompiler(void);
+
+/* Descarta o estado da compilacao anterior (mapeamento do fonte,
+   tokens, tabela de nomes, tabela de simbolos, arvore sintatica,
+   contadores, texto da listagem ainda nao entregue) para que o contexto possa compilar outro programa. Os
+   arquivos nao sao fechados e a memoria ja alocada para os tokens, para
+   a tabela de nomes e para a arena eh reaproveitada.
+   A arvore devolvida por parse deixa de ser valida. */
+void resetCompiler(PmCompiler *);
+
+/* Libera o contexto e todo o estado que ele possui */
+void freeCompiler(PmCompiler *);
+
+#endif
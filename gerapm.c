@@ -0,0 +1,204 @@
+/****************************************************/
+/* File: gerapm.c                                   */
+/* Gerador de programas P- sinteticos para medicao  */
+/* de desempenho (ver bench.c)                      */
+/* Uso: gerapm [opcoes] > programa.pm               */
+/****************************************************/
+
+/* O programa gerado eh valido: todas as variaveis sao declaradas e as
+   expressoes so usam variaveis inteiras, entao todas as fases do
+   compilador o processam sem erro. Cada parte eh controlada por uma
+   opcao, para medir separadamente:
+     -d N  N variaveis declaradas (linhas "inteiro v0, v1, ...;")
+     -a M  M atribuicoes com expressoes longas
+     -e T  T termos por expressao
+     -n P  blocos se/enquanto/repita aninhados com profundidade P
+     -b B  numero de blocos aninhados
+     -c C  C comentarios de uma linha por comando
+     -s S  semente do gerador pseudo-aleatorio
+     -x X  programa para executar (pmi): as variaveis comecam com
+           constantes em vez de ler, as atribuicoes ficam num laco
+           enquanto de X voltas e so se divide por constantes, entao a
+           execucao termina sem erro; -n e -b sao ignorados
+   Exemplos:
+     gerapm -d 20000                   declaracoes
+     gerapm -a 100000 -e 32            expressoes longas
+     gerapm -d 2 -a 1 -e 400000        uma expressao muito longa (a
+                                       pilha das fases e de pmc -c)
+     gerapm -a 1000 -n 100 -b 2000     blocos profundos
+     gerapm -a 100000 -c 4             muitos comentarios
+     gerapm -d 50 -a 200 -x 100000     execucao no interpretador
+     gerapm -d 2 -a 1 -e 400000 -x 1   expressao muito longa compilada
+                                       e executada por pmi */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static long decls = 1000, assigns = 10000, terms = 8;
+static long depth = 0, blocks = 0, comments = 0, iterations = 0;
+static unsigned long long seed = 1;
+
+/* Gerador congruente linear: a mesma semente gera o mesmo programa em
+   qualquer plataforma */
+static unsigned long nextRandom(void) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned long) (seed >> 33);
+}
+
+static long pick(long n) {
+    return (long) (nextRandom() % (unsigned long) n);
+}
+
+static const char *ops[] = {"+", "-", "*", "/"};
+static const char *relops[] = {"<", "<=", ">", ">=", "==", "!="};
+
+/* A indentacao para de crescer a partir de 16 niveis, para que blocos
+   muito profundos nao sejam quase so brancos */
+static void indent(int level) {
+    int i;
+    for (i = 0; i < level && i < 16; i++) fputs("  ", stdout);
+}
+
+static void comment(int level) {
+    long i;
+    for (i = 0; i < comments; i++) {
+        indent(level);
+        printf("/* comentario %ld: valor intermediario de v%ld */\n",
+               i, pick(decls));
+    }
+}
+
+/* Um fator: variavel, constante ou subexpressao entre parenteses */
+static void factor(void) {
+    long k = pick(10);
+    if (k < 6)
+        printf("v%ld", pick(decls));
+    else if (k < 9)
+        printf("%ld", pick(100000));
+    else {
+        putchar('(');
+        printf("v%ld %s %ld", pick(decls), ops[pick(2)], pick(1000) + 1);
+        putchar(')');
+    }
+}
+
+/* Com -x, o divisor eh sempre uma constante diferente de zero */
+static void expression(long n) {
+    long i;
+    factor();
+    for (i = 1; i < n; i++) {
+        long op = pick(4);
+        printf(" %s ", ops[op]);
+        if (iterations > 0 && op == 3)
+            printf("%ld", pick(1000) + 1);
+        else
+            factor();
+    }
+}
+
+static void condition(void) {
+    printf("v%ld %s v%ld", pick(decls), relops[pick(6)], pick(decls));
+}
+
+static void assignment(int level) {
+    comment(level);
+    indent(level);
+    printf("v%ld = ", pick(decls));
+    expression(terms);
+    puts(";");
+}
+
+/* Bloco aninhado: alterna se/enquanto/repita ate a profundidade dada */
+static void nested(int level, long remaining) {
+    long kind = remaining % 3;
+    if (remaining == 0) {
+        assignment(level);
+        return;
+    }
+    indent(level);
+    if (kind == 0) {
+        fputs("se ", stdout);
+        condition();
+        puts(" entao {");
+        nested(level + 1, remaining - 1);
+        indent(level);
+        puts("} senao {");
+        assignment(level + 1);
+        indent(level);
+        puts("}");
+    } else if (kind == 1) {
+        fputs("enquanto ", stdout);
+        condition();
+        puts(" {");
+        nested(level + 1, remaining - 1);
+        indent(level);
+        puts("}");
+    } else {
+        puts("repita {");
+        nested(level + 1, remaining - 1);
+        indent(level);
+        fputs("} ate ", stdout);
+        condition();
+        puts("");
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-d declaracoes] [-a atribuicoes] [-e termos]\n"
+        "          [-n profundidade -b blocos] [-c comentarios] [-s semente]\n"
+        "          [-x voltas]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    long i;
+    for (i = 1; i < argc; i++) {
+        long v;
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc)
+            usage(argv[0]);
+        v = atol(argv[i + 1]);
+        switch (argv[i][1]) {
+            case 'd': decls = v; break;
+            case 'a': assigns = v; break;
+            case 'e': terms = v; break;
+            case 'n': depth = v; break;
+            case 'b': blocks = v; break;
+            case 'c': comments = v; break;
+            case 's': seed = (unsigned long long) v; break;
+            case 'x': iterations = v; break;
+            default: usage(argv[0]);
+        }
+        i++;
+    }
+    if (decls < 1) decls = 1;
+    if (terms < 1) terms = 1;
+    if (depth > 0 && blocks == 0) blocks = 1;
+    if (iterations > 0) blocks = 0;
+
+    for (i = 0; i < decls; i++) {
+        printf(i % 8 == 0 ? "inteiro v%ld" : ", v%ld", i);
+        if (i % 8 == 7 || i == decls - 1) puts(";");
+    }
+    if (iterations > 0) {
+        puts("inteiro volta;");
+        for (i = 0; i < decls; i++)
+            printf("v%ld = %ld;\n", i, pick(1000) + 1);
+        puts("volta = 0;");
+        printf("enquanto volta < %ld {\n", iterations);
+        for (i = 0; i < assigns; i++)
+            assignment(1);
+        puts("  volta = volta + 1;");
+        puts("}");
+    } else {
+        for (i = 0; i < decls; i += 97)
+            printf("ler(v%ld);\n", i);
+        for (i = 0; i < assigns; i++)
+            assignment(0);
+    }
+    for (i = 0; i < blocks; i++)
+        nested(0, depth);
+    printf("mostrar(v%ld);\n", pick(decls));
+    return 0;
+}
@@ -20,6 +20,13 @@
 #define TRUE 1
 #endif
 
+/* Arquivo que descarta o que eh escrito nele */
+#ifdef _WIN32
+#define NULL_FILE "NUL"
+#else
+#define NULL_FILE "/dev/null"
+#endif
+
 /* MAXRESERVED = quantidade máxima de palavras reservadas */
 #define MAXRESERVED 10
 
@@ -71,11 +78,10 @@ typedef enum {
    ERROR,
 } TokenType;
 
-extern FILE *source; /* arquivo de codigo fonte */
-extern FILE *listing; /* arquivo com texto de saida */
-extern FILE *code; /* arquivo de codigo para a maquina alvo */
-
-extern int lineno; /* numero da linha do codigo fonte */
+/* Contexto de uma compilacao (definido em compiler.h). Guarda os
+   arquivos, a linha corrente, o estado da varredura, do parser e a tabela
+   de simbolos, de modo que varias compilacoes podem rodar ao mesmo tempo. */
+typedef struct PmCompiler PmCompiler;
 
 /*************************************************/
 /*******  Arvore sintatica para o parser  ********/
@@ -90,6 +96,12 @@ typedef enum {Void,Integer,Real,Boolean} ExpType; // Isso faz parte do analisado
 
 #define MAXCHILDREN 3
 
+/* Valor de uma constante numerica, convertido pela varredura */
+typedef union {
+  long long vint;
+  double vreal;
+} NumValue;
+
 typedef struct treeNode
    { struct treeNode * child[MAXCHILDREN];
      struct treeNode * sibling;
@@ -97,14 +109,17 @@ typedef struct treeNode
      NodeKind nodekind;
      union { StmtKind stmt; ExpKind exp;} kind;
      union { TokenType op;
-             union {
-               int vint;
-               float vreal;
-             } val;
-             char * name; } attr;
+             NumValue val;
+             int id; /* identificador, como id da tabela de nomes (intern.h) */
+           } attr;
      ExpType type; /* para checagem de tipo das espressoes */
+     int sym; /* simbolo da variavel (symtab.h) em AssignK, ReadK e IdK,
+                 dado por buildSymtab; -1 antes */
    } TreeNode;
 
+/* Arvore sintatica compacta, com os nos em arrays (definida em ast.h) */
+typedef struct AstTree AstTree;
+
 /*****************************************************/
 /***********   Flags para rastreamento    ************/
 /*****************************************************/
@@ -126,10 +141,10 @@ extern int TraceScan;
    tabela de simbolos serem mostradas no arquivo listing */
 extern int TraceAnalyze;
 
-/* TraceCode = TRUE faz os comentarios serem gravados no
-   arquivo de codigo da maquina alvo quando o codigo eh gerado */
+/* TraceCode = TRUE faz o codigo gerado ser mostrado, com
+   comentarios, no arquivo listing (o arquivo de codigo eh binario) */
 extern int TraceCode;
 
-/* Error = TRUE previne passadas futuras se ocorrer um erro */
-extern int Error; 
+/* Os flags acima sao apenas lidos durante a compilacao; o indicador de
+   erro de cada compilacao fica em PmCompiler */
 #endif
@@ -0,0 +1,372 @@
+/****************************************************/
+/* File: incr.c                                     */
+/* Incremental reparsing for the P- compiler        */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "scan.h"
+#include "parse.h"
+#include "symtab.h"
+#include "incr.h"
+#include "compiler.h"
+
+/* Resultados de parseWindow alem do indice do comando reencontrado */
+#define WINDOW_SHORT (-1) /* a janela acabou sem reencontrar um comando antigo */
+#define PROGRAM_END (-2) /* a sequencia de comandos do programa terminou */
+#define OUT_OF_MEMORY (-3)
+
+/* Id do nome citado no no (atribuicao, leitura ou identificador), ou -1 */
+static int nodeName(TreeNode * t) {
+  if (t->nodekind == StmtK)
+    return (t->kind.stmt == AssignK || t->kind.stmt == ReadK) ? t->attr.id : -1;
+  return (t->kind.exp == IdK) ? t->attr.id : -1;
+}
+
+/* Garante espaco para n comandos em *spans */
+static int reserveSpans(PmCompiler * pm, StmtSpan ** spans, int * capacity, int n) {
+  int cap = *capacity ? *capacity : 256;
+  StmtSpan * grown;
+  if (n <= *capacity)
+    return TRUE;
+  while (cap < n)
+    cap *= 2;
+  grown = (StmtSpan *) realloc(*spans, cap * sizeof(StmtSpan));
+  if (grown == NULL) {
+    fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
+    return FALSE;
+  }
+  *spans = grown;
+  *capacity = cap;
+  return TRUE;
+}
+
+/* Garante uma marca e espaco em pm->touched para cada nome */
+static int reserveNames(PmCompiler * pm) {
+  int n = pm->nameCount;
+  if (n > pm->idMarkSize) {
+    int cap = 2 * n;
+    unsigned char * mark = (unsigned char *) realloc(pm->idMark, cap);
+    if (mark == NULL) {
+      fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
+      return FALSE;
+    }
+    memset(mark + pm->idMarkSize, 0, cap - pm->idMarkSize);
+    pm->idMark = mark;
+    pm->idMarkSize = cap;
+  }
+  if (n > pm->touchedCapacity) {
+    int cap = 2 * n;
+    int * touched = (int *) realloc(pm->touched, cap * sizeof(int));
+    if (touched == NULL) {
+      fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
+      return FALSE;
+    }
+    pm->touched = touched;
+    pm->touchedCapacity = cap;
+  }
+  return TRUE;
+}
+
+/* Acrescenta id a pm->touched, se ainda nao estiver la */
+static void markTouched(PmCompiler * pm, int id) {
+  if (!pm->idMark[id]) {
+    pm->idMark[id] = TRUE;
+    pm->touched[pm->ntouched++] = id;
+  }
+}
+
+/* Visita que junta em pm->touched os nomes citados */
+static void touchNode(PmCompiler * pm, TreeNode * t) {
+  int id = nodeName(t);
+  if (id >= 0)
+    markTouched(pm,id);
+}
+
+/* Visita que insere na tabela de simbolos a citacao do no, como
+   insertNode (analyze.c), na posicao da sua linha */
+static void insertCitation(PmCompiler * pm, TreeNode * t) {
+  int id = nodeName(t);
+  if (id < 0)
+    return;
+  markTouched(pm,id);
+  t->sym = st_insert_sorted(pm,id,t->lineno,t->type);
+}
+
+/* Visita que soma pm->lineShift a linha do no */
+static void shiftNode(PmCompiler * pm, TreeNode * t) {
+  t->lineno += pm->lineShift;
+}
+
+/* Percorre so o comando t, sem os seus irmaos */
+static void walkStmt(PmCompiler * pm, TreeNode * t, TreeVisitor visit) {
+  TreeNode * sibling;
+  if (t == NULL)
+    return;
+  sibling = t->sibling;
+  t->sibling = NULL;
+  walkTree(pm,t,visit,NULL);
+  t->sibling = sibling;
+}
+
+/* TRUE se o comando antigo k comeca numa linha depois do fim do
+   anterior: as citacoes antes dele e as dele em diante ficam em linhas
+   separadas */
+static int lineBreakBefore(PmCompiler * pm, int k) {
+  return pm->spans[k-1].lastLine < pm->spans[k].line;
+}
+
+/* Ultimo comando que comeca em offset ou antes, ou -1 */
+static int spanAt(PmCompiler * pm, long offset) {
+  int lo = 0, hi = pm->nspans - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if ((long) pm->spans[mid].start <= offset)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return hi;
+}
+
+/* Quantidade de quebras de linha nos n bytes de s */
+static int countNewlines(const char * s, long n) {
+  const char * end = s + n;
+  int lines = 0;
+  while ((s = memchr(s, '\n', end - s)) != NULL) {
+    lines++;
+    s++;
+  }
+  return lines;
+}
+
+/* Troca os removed bytes em start pelos added bytes de text no buffer */
+static int editText(PmCompiler * pm, long start, long removed, const char * text, long added) {
+  long size = pm->sourceSize - removed + added;
+  char * buf = (char *) pm->sourceText;
+  if (size > pm->textCapacity) {
+    long cap = 2 * size;
+    if ((buf = (char *) realloc(buf, cap)) == NULL) {
+      fprintf(pm->listing,"Out of memory error editing source\n");
+      return FALSE;
+    }
+    pm->sourceText = buf;
+    pm->textCapacity = cap;
+  }
+  memmove(buf + start + added, buf + start + removed, pm->sourceSize - start - removed);
+  memcpy(buf + start, text, added);
+  pm->sourceSize = size;
+  return TRUE;
+}
+
+/* Varre [from, to) do texto, a partir da linha line, e analisa os
+   comandos do nivel mais alto que comecam ali, guardando-os em pm->fresh.
+   A analise para no primeiro passo que comeca exatamente no inicio,
+   deslocado por delta, de um comando antigo k >= k0, se tanto no texto
+   novo quanto no antigo esse comando comeca numa linha depois do fim do
+   anterior: dali em diante os tokens e a analise sao os mesmos de antes.
+   Retorna esse k, PROGRAM_END se a sequencia de comandos terminou antes,
+   WINDOW_SHORT se a analise chegou ao fim da janela, que nao eh o fim do
+   texto, ou OUT_OF_MEMORY. */
+static int parseWindow(PmCompiler * pm, long from, long to, int line, int k0, long delta) {
+  int k = k0, atEnd = (to == pm->sourceSize), more = TRUE;
+  pm->cur = pm->sourceText + from;
+  pm->end = pm->sourceText + to;
+  pm->lineno = line;
+  if (!scanAll(pm,&pm->tokens))
+    return OUT_OF_MEMORY;
+  parseStart(pm);
+  pm->nfresh = 0;
+  while (more) {
+    long offset = (long) pm->tokens.offset[pm->pos];
+    int pos = pm->pos, error = pm->error;
+    StmtSpan * s;
+    if (pos == pm->tokens.count - 1 && !atEnd)
+      return WINDOW_SHORT;
+    if (pos > 0) {
+      while (k < pm->nspans && pm->spans[k].start + delta < offset)
+        k++;
+      if (k < pm->nspans && pm->spans[k].start + delta == offset &&
+          pm->tokens.line[pos-1] < pm->tokens.line[pos] && lineBreakBefore(pm,k))
+        return k;
+    }
+    if (!reserveSpans(pm,&pm->fresh,&pm->freshCapacity,pm->nfresh + 1))
+      return OUT_OF_MEMORY;
+    s = &pm->fresh[pm->nfresh++];
+    s->start = (unsigned int) offset;
+    s->line = pm->tokens.line[pos];
+    pm->error = FALSE;
+    more = parseTopStatement(pm,&s->stmt);
+    s->lastLine = (pm->pos > pos) ? pm->tokens.line[pm->pos-1] : s->line;
+    s->error = pm->error;
+    pm->error = error || s->error;
+  }
+  if (pm->pos == pm->tokens.count - 1 && !atEnd)
+    return WINDOW_SHORT;
+  return PROGRAM_END;
+}
+
+/* Refaz o encadeamento dos comandos em volta de [lo, hi) */
+static void linkSpans(PmCompiler * pm, int lo, int hi) {
+  TreeNode * prev = NULL, * next = NULL;
+  int i;
+  for (i = lo - 1; i >= 0 && prev == NULL; i--)
+    prev = pm->spans[i].stmt;
+  for (i = hi; i < pm->nspans && next == NULL; i++)
+    next = pm->spans[i].stmt;
+  for (i = lo; i < hi; i++) {
+    TreeNode * t = pm->spans[i].stmt;
+    if (t == NULL)
+      continue;
+    if (prev == NULL)
+      pm->incrRoot = t;
+    else
+      prev->sibling = t;
+    prev = t;
+  }
+  if (prev == NULL)
+    pm->incrRoot = next;
+  else
+    prev->sibling = next;
+}
+
+/* Troca os comandos antigos a partir de first pelos de pm->fresh. r eh
+   o resultado de parseWindow: o comando antigo reencontrado, cujo
+   deslocamento e linhas mudam de delta e lineDelta junto com os
+   seguintes, ou PROGRAM_END, quando nenhum comando antigo fica. As
+   citacoes na tabela de simbolos ficam ordenadas por linha, e as linhas
+   dos comandos trocados nao se misturam com as dos outros, entao basta
+   tirar as citacoes das linhas antigas e inserir as dos comandos novos. */
+static int install(PmCompiler * pm, int first, int r, long delta, int lineDelta) {
+  int end = (r == PROGRAM_END) ? pm->nspans : r;
+  int tail = pm->nspans - end;
+  int i;
+  if (!reserveNames(pm) ||
+      !reserveSpans(pm,&pm->spans,&pm->spansCapacity,first + pm->nfresh + tail))
+    return FALSE;
+  /* citacoes dos comandos que saem */
+  pm->ntouched = 0;
+  if (end > first) {
+    int oldFirst = (first > 0) ? pm->spans[first].line : 0;
+    int oldLast = pm->spans[end-1].lastLine;
+    for (i = first; i < end; i++) {
+      pm->syntaxErrors -= pm->spans[i].error;
+      walkStmt(pm,pm->spans[i].stmt,touchNode);
+    }
+    for (i = 0; i < pm->ntouched; i++)
+      st_remove_lines(pm,pm->touched[i],oldFirst,oldLast);
+    if (tail > 0 && lineDelta != 0)
+      st_shift_lines(pm,oldLast + 1,lineDelta);
+  }
+  /* comandos que ficam depois da edicao */
+  if (r == PROGRAM_END)
+    pm->stopOffset = pm->tokens.offset[pm->pos];
+  else {
+    pm->lineShift = lineDelta;
+    for (i = r; i < pm->nspans; i++) {
+      pm->spans[i].start += delta;
+      if (lineDelta != 0) {
+        pm->spans[i].line += lineDelta;
+        pm->spans[i].lastLine += lineDelta;
+        walkStmt(pm,pm->spans[i].stmt,shiftNode);
+      }
+    }
+    pm->stopOffset += delta;
+  }
+  memmove(pm->spans + first + pm->nfresh, pm->spans + end, tail * sizeof(StmtSpan));
+  memcpy(pm->spans + first, pm->fresh, pm->nfresh * sizeof(StmtSpan));
+  pm->nspans = first + pm->nfresh + tail;
+  /* citacoes dos comandos novos */
+  for (i = first; i < first + pm->nfresh; i++) {
+    pm->syntaxErrors += pm->spans[i].error;
+    walkStmt(pm,pm->spans[i].stmt,insertCitation);
+  }
+  linkSpans(pm,first,first + pm->nfresh);
+  for (i = 0; i < pm->ntouched; i++)
+    pm->idMark[pm->touched[i]] = FALSE;
+  pm->error = pm->syntaxErrors > 0 || (long) pm->stopOffset < pm->sourceSize;
+  return TRUE;
+}
+
+/* Copia o texto e analisa o programa inteiro */
+int incrOpen(PmCompiler * pm, const char * text, long size) {
+  long cap = size + size / 2 + 4096;
+  char * buf = (char *) malloc(cap);
+  if (buf == NULL) {
+    fprintf(pm->listing,"Out of memory error reading source\n");
+    return FALSE;
+  }
+  memcpy(buf,text,size);
+  resetCompiler(pm);
+  pm->sourceText = buf;
+  pm->sourceSize = size;
+  pm->textCapacity = cap;
+  if (parseWindow(pm,0,size,1,0,0) == OUT_OF_MEMORY)
+    return FALSE;
+  parseFinish(pm);
+  return install(pm,0,PROGRAM_END,0,0);
+}
+
+/* Aplica uma edicao e analisa de novo os comandos afetados */
+int incrEdit(PmCompiler * pm, long start, long removed, const char * text, long added) {
+  long oldEnd = start + removed, delta = added - removed, from, to;
+  int first, k0, line, lineDelta, r, error, i;
+  FILE * listing = pm->listing;
+  if (pm->nspans == 0 || start < 0 || removed < 0 || added < 0 || oldEnd > pm->sourceSize)
+    return -1;
+  lineDelta = countNewlines(text,added) - countNewlines(pm->sourceText + start,removed);
+  if (!editText(pm,start,removed,text,added))
+    return -1;
+  /* O comando em que a edicao comeca eh analisado de novo, e tambem o
+     anterior, cujo fim foi decidido pelo primeiro token do seguinte. A
+     regiao comeca numa linha depois do fim do comando que fica antes. */
+  first = spanAt(pm,start) - 1;
+  if (first < 0)
+    first = 0;
+  while (first > 0 && !lineBreakBefore(pm,first))
+    first--;
+  from = (first > 0) ? (long) pm->spans[first].start : 0;
+  line = (first > 0) ? pm->spans[first].line : 1;
+  /* A analise pode se reencontrar a partir do primeiro comando antigo
+     que comeca depois da edicao, numa linha depois do fim do anterior;
+     a janela varrida vai ate o comando seguinte */
+  for (k0 = first + 1; k0 < pm->nspans && (pm->spans[k0].start < oldEnd || !lineBreakBefore(pm,k0)); k0++)
+    ;
+  to = (k0 + 1 < pm->nspans) ? pm->spans[k0+1].start + delta : pm->sourceSize;
+  /* Primeira tentativa sem listagem: se a janela for curta ou houver
+     erros, a analise eh refeita (ate o fim do texto, no primeiro caso)
+     e os erros sao mostrados uma unica vez */
+  if (pm->quiet == NULL)
+    pm->quiet = fopen(NULL_FILE,"w");
+  r = WINDOW_SHORT;
+  if (pm->quiet != NULL) {
+    pm->listing = pm->quiet;
+    r = parseWindow(pm,from,to,line,k0,delta);
+    pm->listing = listing;
+  }
+  for (error = FALSE, i = 0; i < pm->nfresh; i++)
+    error |= pm->fresh[i].error;
+  if (r == WINDOW_SHORT || r == OUT_OF_MEMORY || error) {
+    if (r == WINDOW_SHORT || r == OUT_OF_MEMORY)
+      to = pm->sourceSize;
+    r = parseWindow(pm,from,to,line,k0,delta);
+  }
+  if (r == OUT_OF_MEMORY)
+    return -1;
+  if (r == PROGRAM_END)
+    parseFinish(pm);
+  if (!install(pm,first,r,delta,lineDelta))
+    return -1;
+  return pm->nfresh;
+}
+
+/* Arvore sintatica corrente */
+TreeNode * incrTree(PmCompiler * pm) {
+  return pm->incrRoot;
+}
+
+/* Nomes cujas citacoes mudaram na ultima edicao */
+int incrTouched(PmCompiler * pm, const int ** ids) {
+  *ids = pm->touched;
+  return pm->ntouched;
+}
@@ -0,0 +1,42 @@
+/****************************************************/
+/* File: incr.h                                     */
+/* Incremental reparsing for the P- compiler        */
+/****************************************************/
+
+#ifndef _INCR_H_
+#define _INCR_H_
+
+/* Reanalise incremental, para integracao com editores. O fonte fica num
+   buffer editavel (pm->sourceText) e cada comando do nivel mais alto do
+   programa guarda a sua extensao no texto. Uma edicao varre e analisa de
+   novo so os comandos que ela pode ter mudado, ate reencontrar o inicio
+   de um comando antigo, e troca esses comandos na arvore. Na tabela de
+   simbolos so as citacoes dos comandos trocados mudam; um nome que
+   passa a ser citado recebe uma nova localizacao de memoria. Uma edicao
+   que muda o numero de linhas ainda soma a diferenca em todos os nos e
+   citacoes depois dela.
+   Os nos dos comandos trocados continuam na arena ate o proximo
+   incrOpen ou resetCompiler. pm->tokens passa a guardar so os tokens da
+   ultima reanalise. teste_incr aplica edicoes aleatorias e confere o
+   resultado com o de uma compilacao completa do texto editado. */
+
+/* Copia os size bytes de text (que pode ser o proprio pm->sourceText),
+   descartando a compilacao anterior, analisa o programa inteiro e monta
+   a tabela de simbolos. Retorna FALSE se faltar memoria. */
+int incrOpen(PmCompiler *, const char *, long);
+
+/* Troca os removed bytes que comecam em start pelos added bytes de text
+   e atualiza a arvore e a tabela de simbolos. Os erros sintaticos dos
+   comandos reanalisados sao mostrados na listagem. Retorna quantos
+   comandos foram analisados de novo, ou -1 se o trecho for invalido ou
+   faltar memoria (nesse caso o programa deve ser reaberto com incrOpen). */
+int incrEdit(PmCompiler *, long start, long removed, const char * text, long added);
+
+/* Arvore sintatica corrente, a mesma que parse montaria para o texto */
+TreeNode * incrTree(PmCompiler *);
+
+/* Ids (intern.h) dos nomes citados nos comandos trocados pela ultima
+   edicao; retorna quantos sao */
+int incrTouched(PmCompiler *, const int **);
+
+#endif
@@ -0,0 +1,119 @@
+/****************************************************/
+/* File: intern.c                                   */
+/* Identifier name table for the P- compiler        */
+/* (one table per compilation context)              */
+/* Open addressing hash table of dense ids          */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "intern.h"
+#include "compiler.h"
+
+/* Numero inicial de posicoes da tabela (potencia de 2) */
+#define INTERN_SLOTS 1024
+
+/* Hash FNV-1a de 32 bits */
+static unsigned hashName(const char * s, int len) {
+  unsigned h = 2166136261u;
+  int i;
+  for (i = 0; i < len; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* Dobra a quantidade de posicoes, reinserindo as ocupadas pelo hash
+   guardado nelas. A tabela fica no maximo meio cheia, entao a sondagem
+   linear eh curta. */
+static int growSlots(PmCompiler * pm) {
+  unsigned n = pm->internSlots ? 2 * (pm->internMask + 1) : INTERN_SLOTS;
+  InternSlot * slots = (InternSlot *) calloc(n, sizeof(InternSlot));
+  unsigned i, j;
+  if (slots == NULL) return FALSE;
+  for (j = 0; pm->internSlots != NULL && j <= pm->internMask; j++) {
+    if (pm->internSlots[j].id == 0) continue;
+    i = pm->internSlots[j].hash & (n - 1);
+    while (slots[i].id != 0)
+      i = (i + 1) & (n - 1);
+    slots[i] = pm->internSlots[j];
+  }
+  free(pm->internSlots);
+  pm->internSlots = slots;
+  pm->internMask = n - 1;
+  return TRUE;
+}
+
+/* Garante espaco para mais um id no array de nomes */
+static int growNames(PmCompiler * pm) {
+  int n = pm->nameCapacity ? 2 * pm->nameCapacity : INTERN_SLOTS / 2;
+  const char ** names = (const char **) realloc((void *) pm->names, n * sizeof(char *));
+  if (names == NULL) return FALSE;
+  pm->names = names;
+  pm->nameCapacity = n;
+  return TRUE;
+}
+
+/* Mostra o erro de falta de memoria e retorna o id invalido */
+static int outOfMemory(PmCompiler * pm) {
+  fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
+  return -1;
+}
+
+/* Retorna o id do nome, inserindo-o se for novo */
+int internName(PmCompiler * pm, const char * s, int len) {
+  unsigned h = hashName(s, len);
+  unsigned i;
+  int id;
+  char * copy;
+  if (2 * (unsigned) (pm->nameCount + 1) > pm->internMask + 1 && !growSlots(pm))
+    return outOfMemory(pm);
+  for (i = h & pm->internMask; pm->internSlots[i].id != 0; i = (i + 1) & pm->internMask) {
+    if (pm->internSlots[i].hash == h && pm->internSlots[i].length == len) {
+      id = pm->internSlots[i].id - 1;
+      if (memcmp(pm->names[id], s, len) == 0)
+        return id;
+    }
+  }
+  /* Nome novo: a copia fica na arena e vive ate o fim da compilacao */
+  if (pm->nameCount == pm->nameCapacity && !growNames(pm))
+    return outOfMemory(pm);
+  if ((copy = copyLexeme(pm, s, len)) == NULL)
+    return -1;
+  id = pm->nameCount++;
+  pm->names[id] = copy;
+  pm->internSlots[i].hash = h;
+  pm->internSlots[i].length = len;
+  pm->internSlots[i].id = id + 1;
+  return id;
+}
+
+/* Retorna o nome do id */
+const char * internString(PmCompiler * pm, int id) {
+  if (id < 0 || id >= pm->nameCount)
+    return "";
+  return pm->names[id];
+}
+
+/* Quantidade de nomes distintos */
+int internCount(PmCompiler * pm) {
+  return pm->nameCount;
+}
+
+/* Esvazia a tabela. Os nomes estao na arena e sao descartados com ela. */
+void internClear(PmCompiler * pm) {
+  if (pm->nameCount > 0)
+    memset(pm->internSlots, 0, (pm->internMask + 1) * sizeof(InternSlot));
+  pm->nameCount = 0;
+}
+
+/* Libera a memoria da tabela */
+void internFree(PmCompiler * pm) {
+  free(pm->internSlots);
+  free((void *) pm->names);
+  pm->internSlots = NULL;
+  pm->names = NULL;
+  pm->internMask = 0;
+  pm->nameCount = pm->nameCapacity = 0;
+}
@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: intern.h                                   */
+/* Identifier name table for the P- compiler        */
+/* (one table per compilation context)              */
+/****************************************************/
+
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+/* Cada identificador distinto eh guardado uma unica vez e recebe um id
+   denso: 0, 1, 2, ... na ordem da primeira ocorrencia. A arvore
+   sintatica e a tabela de simbolos guardam so o id, entao comparar
+   nomes eh comparar inteiros. */
+
+/* Retorna o id do nome de len caracteres que comeca em s, inserindo-o
+   se ainda nao estiver na tabela. Retorna -1 se faltar memoria. */
+int internName(PmCompiler * pm, const char * s, int len);
+
+/* Retorna o nome (terminado por '\0') do id, ou "" se o id for invalido */
+const char * internString(PmCompiler * pm, int id);
+
+/* Quantidade de nomes distintos na tabela */
+int internCount(PmCompiler * pm);
+
+/* Esvazia a tabela, mantendo a memoria para a proxima compilacao */
+void internClear(PmCompiler * pm);
+
+/* Libera a memoria da tabela */
+void internFree(PmCompiler * pm);
+
+#endif
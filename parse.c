@@ -5,60 +5,80 @@
 
 #include "globals.h"
 #include "util.h"
+#include "intern.h"
 #include "scan.h"
 #include "parse.h"
+#include "compiler.h"
 
-static TokenType token; /* Armazena o token corrente */
+/* Lexema do token corrente */
+#define LEXEME (pm->sourceText + pm->tokens.offset[pm->pos])
+#define LEXLEN (pm->tokens.length[pm->pos])
+
+/* Avanca para o proximo token do fluxo. O ultimo token eh ENDFILE,
+   que nunca eh ultrapassado. */
+static void advance(PmCompiler * pm) {
+  if (pm->pos < pm->tokens.count - 1)
+    pm->pos++;
+  pm->token = (TokenType) pm->tokens.kind[pm->pos];
+  pm->lineno = pm->tokens.line[pm->pos];
+}
+
+/* Id do lexema do token corrente na tabela de nomes */
+static int internToken(PmCompiler * pm) {
+  return internName(pm, LEXEME, LEXLEN);
+}
 
 /* Prototipos de funcoes para as chamadas recursivas */
-static TreeNode * stmt_sequence(void);
-static TreeNode * statement(void);
-static TreeNode * decl(void);
-static TreeNode * if_stmt(void);
-static TreeNode * while_stmt(void);
-static TreeNode * repeat_stmt(void);
-static TreeNode * assign_stmt(void);
-static TreeNode * read_stmt(void);
-static TreeNode * write_stmt(void);
-static TreeNode * expr(void);
-static TreeNode * simple_exp(void);
-static TreeNode * term(void);
-static TreeNode * factor(void);
+static TreeNode * stmt_sequence(PmCompiler * pm);
+static TreeNode * statement(PmCompiler * pm);
+static TreeNode * decl(PmCompiler * pm);
+static TreeNode * if_stmt(PmCompiler * pm);
+static TreeNode * while_stmt(PmCompiler * pm);
+static TreeNode * repeat_stmt(PmCompiler * pm);
+static TreeNode * assign_stmt(PmCompiler * pm);
+static TreeNode * read_stmt(PmCompiler * pm);
+static TreeNode * write_stmt(PmCompiler * pm);
+static TreeNode * expr(PmCompiler * pm);
+static TreeNode * factor(PmCompiler * pm);
 
 /* Funcao para mostrar aviso de erro sintatico */
-static void syntaxError(char *message) {
-  fprintf(listing,"\n>>> ");
-  fprintf(listing,"Syntax error at line %d: %s",lineno,message);
-  Error = TRUE;
+static void syntaxError(PmCompiler * pm, char *message) {
+  fprintf(pm->listing,"\n>>> ");
+  fprintf(pm->listing,"Syntax error at line %d: %s",pm->lineno,message);
+  pm->error = TRUE;
 }
 
 /* Verifica se o token esperado é o token corrente.
    Caso afirmativo, pega o proximo token. */
-static void match(TokenType expected) {
-  if (token == expected)
-    token = getToken();
+static void match(PmCompiler * pm, TokenType expected) {
+  if (pm->token == expected)
+    advance(pm);
   else {
-    syntaxError("unexpected token -> ");
-    printToken(token,tokenString);
-    fprintf(listing,"      ");
+    syntaxError(pm,"unexpected token -> ");
+    printToken(pm,pm->token,LEXEME,LEXLEN);
+    fprintf(pm->listing,"      ");
   }
 }
 
+/* Depois de um comando da sequencia, consome o ';' que o separa do
+   proximo. Retorna FALSE se a sequencia termina no token corrente. */
+static int sequence_next(PmCompiler * pm) {
+  if ((pm->token==ENDFILE) || (pm->token==FECHA_BLOCO_COMANDOS) || (pm->token==SENAO) || (pm->token==ATE))
+    return FALSE;
+  if(pm->token==SEPARADOR_COMANDO)
+    match(pm,SEPARADOR_COMANDO); /* Captura ponto e virgula */
+  if (pm->token==FECHA_BLOCO_COMANDOS)
+    return FALSE;
+  return TRUE;
+}
+
 /* Avalia sequência de declarações */
 /* decl-sequencia -> { declaracao; } | ENDFILE | FECHA_BLOCO_COMANDOS */
-TreeNode *stmt_sequence(void) {
-  TreeNode *t = statement(); /* Monta no com primeira declaracao */
-  TreeNode *p = t;
-  while ((token!=ENDFILE) && (token!=FECHA_BLOCO_COMANDOS) && (token!=SENAO) && (token!=ATE)) {
-    TreeNode * q;
-    if(token==ENDFILE)
-      break;
-    if(token==SEPARADOR_COMANDO)
-      match(SEPARADOR_COMANDO); /* Captura ponto e virgula */
-    if (token==FECHA_BLOCO_COMANDOS) {
-      break;
-    }
-    q = statement(); /* Monta no de declaracao */
+TreeNode *stmt_sequence(PmCompiler * pm) {
+  TreeNode *t = NULL;
+  TreeNode *p = NULL;
+  do {
+    TreeNode *q = statement(pm); /* Monta no de declaracao */
     if (q != NULL) {
       if (t == NULL)
         t = p = q;
@@ -67,45 +87,44 @@ TreeNode *stmt_sequence(void) {
         p = q;
       }
     }
-  }
-
+  } while (sequence_next(pm));
   return t;
 }
 
 /* Avalia declaracao */
 /* declaracao -> if-decl | repeat-decl | atribuicao-decl | read-decl | write-decl | ENDFILE */
-TreeNode *statement(void) {
+TreeNode *statement(PmCompiler * pm) {
   TreeNode *t = NULL;
-  switch (token) {
+  switch (pm->token) {
     case INTEIRO:
     case REAL:
-      t = decl();
+      t = decl(pm);
       break;
     case SENAO:
     case SE:
-      t = if_stmt();
+      t = if_stmt(pm);
       break;
     case ENQUANTO:
-      t = while_stmt();
+      t = while_stmt(pm);
       break;
     case REPITA:
-      t = repeat_stmt(); 
+      t = repeat_stmt(pm); 
       break;
     case IDENTIFICADOR:
-      t = assign_stmt(); /* Monta no ATRIBUICAO */
+      t = assign_stmt(pm); /* Monta no ATRIBUICAO */
       break;
      case LER:
-      t = read_stmt();
+      t = read_stmt(pm);
       break;
     case MOSTRAR:
-      t = write_stmt(); 
+      t = write_stmt(pm); 
       break;
     case ENDFILE:
       break;
     default: /* Erro */
-      syntaxError("unexpected token -> ");
-      printToken(token,tokenString);
-      token = getToken();
+      syntaxError(pm,"unexpected token -> ");
+      printToken(pm,pm->token,LEXEME,LEXLEN);
+      advance(pm);
       break;
   } /* end case */
   return t;
@@ -114,24 +133,24 @@ TreeNode *statement(void) {
 /* declaração -> tipo identificador { , identificador } */
 /* tipo -> INTEIRO | REAL */
 /* identificador -> IDENTIFICADOR */
-TreeNode *decl(void) {
+TreeNode *decl(PmCompiler * pm) {
 
-    TreeNode *t = newStmtNode(DeclK); // Cria o nó para a declaração
-    if(token==REAL) {
-      t->attr.name = copyString(tokenString);
+    TreeNode *t = newStmtNode(pm,DeclK); // Cria o nó para a declaração
+    if(pm->token==REAL) {
       t->type = Real;
-      match(REAL);
+      match(pm,REAL);
       if (t != NULL) {
         // Lida com o primeiro identificador
-        t->child[0] = expr(); // Assumindo que expr() retorna um nó para o primeiro identificador
+        t->child[0] = expr(pm); // Assumindo que expr() retorna um nó para o primeiro identificador
         TreeNode *current = t->child[0]; // Começa com o primeiro identificador
-        current->type = Real;
+        if (current != NULL)
+          current->type = Real;
         // Laço para conectar identificadores adicionais
-        while (token == SEPARADOR_ID) {
-          match(SEPARADOR_ID); // Captura o identificador
-          TreeNode *nextId = expr(); // Cria um novo nó para o próximo identificador
-          nextId->type = Real;
-          if (nextId != NULL) {
+        while (pm->token == SEPARADOR_ID) {
+          match(pm,SEPARADOR_ID); // Captura o identificador
+          TreeNode *nextId = expr(pm); // Cria um novo nó para o próximo identificador
+          if (nextId != NULL && current != NULL) {
+            nextId->type = Real;
             // Liga o filho do identificador atual ao novo identificador
             current->sibling = nextId; // Assumindo que você deseja usar sibling para próximos identificadores
             current = nextId; // Move para o identificador recém-adicionado
@@ -139,22 +158,21 @@ TreeNode *decl(void) {
         }
       }
     }
-    if(token==INTEIRO) {
-      t->attr.name = copyString(tokenString);
+    if(pm->token==INTEIRO) {
       t->type = Integer;
-      match(INTEIRO);
+      match(pm,INTEIRO);
       if (t != NULL) {
         // Lida com o primeiro identificador
-        t->child[0] = expr(); // Assumindo que expr() retorna um nó para o primeiro identificador
+        t->child[0] = expr(pm); // Assumindo que expr() retorna um nó para o primeiro identificador
         TreeNode *current = t->child[0]; // Começa com o primeiro identificador
-        current->type = Integer;
+        if (current != NULL)
+          current->type = Integer;
         // Laço para conectar identificadores adicionais
-        while (token == SEPARADOR_ID) {
-          match(SEPARADOR_ID); // Captura o identificador
-          TreeNode *nextId = expr(); // Cria um novo nó para o próximo identificador
-          nextId->type = Integer;
-          
-          if (nextId != NULL) {
+        while (pm->token == SEPARADOR_ID) {
+          match(pm,SEPARADOR_ID); // Captura o identificador
+          TreeNode *nextId = expr(pm); // Cria um novo nó para o próximo identificador
+          if (nextId != NULL && current != NULL) {
+            nextId->type = Integer;
             // Liga o filho do identificador atual ao novo identificador
             current->sibling = nextId; // Assumindo que você deseja usar sibling para próximos identificadores
             current = nextId; // Move para o identificador recém-adicionado
@@ -170,64 +188,62 @@ TreeNode *decl(void) {
 /* comando1 -> stmt | bloco-comandos */
 /* comando2 -> stmt | bloco-comandos */
 /* stmt-sequencia -> declaracao { ; declaracao } */
-TreeNode *if_stmt(void) {
-    TreeNode *t = newStmtNode(IfK); /* Aloca no de declaração IF */
+TreeNode *if_stmt(PmCompiler * pm) {
+    TreeNode *t = newStmtNode(pm,IfK); /* Aloca no de declaração IF */
     
     
-    if (token == SE) {
-        t->attr.name = copyString(tokenString);
-        match(SE); /* Captura SE */
-    }
+    if (pm->token == SE)
+        match(pm,SE); /* Captura SE */
 
     if (t != NULL) {
-        t->child[0] = expr(); /* Monta nó de expressão */
+        t->child[0] = expr(pm); /* Monta nó de expressão */
     }
 
-    if (token == ENTAO) {
-        match(ENTAO); /* Captura ENTAO */
+    if (pm->token == ENTAO) {
+        match(pm,ENTAO); /* Captura ENTAO */
     }
     
 
     /* Verifica se o próximo token é um bloco de comandos ou apenas uma única declaração */
-    if (token == INICIA_BLOCO_COMANDOS) {
-      match(INICIA_BLOCO_COMANDOS); /* Início do bloco de comandos */
+    if (pm->token == INICIA_BLOCO_COMANDOS) {
+      match(pm,INICIA_BLOCO_COMANDOS); /* Início do bloco de comandos */
       if (t != NULL) {
-          t->child[1] = stmt_sequence(); /* Monta nó com sequência de declarações */
+          t->child[1] = stmt_sequence(pm); /* Monta nó com sequência de declarações */
       }
-      match(FECHA_BLOCO_COMANDOS); /* Fecha bloco de comandos */
-    } else if (token == SE) {
+      match(pm,FECHA_BLOCO_COMANDOS); /* Fecha bloco de comandos */
+    } else if (pm->token == SE) {
       /* Aqui tratamos um 'se' aninhado logo após o 'entao' */
       if (t != NULL) {
-        t->child[1] = if_stmt(); /* Chama if_stmt() recursivamente para o 'se' aninhado */
+        t->child[1] = if_stmt(pm); /* Chama if_stmt() recursivamente para o 'se' aninhado */
       }
     } else {
       if (t != NULL) {
-        t->child[1] = statement(); /* Monta nó com uma única declaração */
+        t->child[1] = statement(pm); /* Monta nó com uma única declaração */
       }
     }
 
     /* Verifica se existe a parte SENAO */
-    if (token == SENAO) { /* Se existir parte ELSE */
-        if(token==SENAO) {
-          match(SENAO); /* Captura SENAO */
+    if (pm->token == SENAO) { /* Se existir parte ELSE */
+        if(pm->token==SENAO) {
+          match(pm,SENAO); /* Captura SENAO */
         }
 
         /* Verifica se o próximo token é um bloco de comandos ou apenas uma única declaração */
-        if (token == INICIA_BLOCO_COMANDOS) {
-          match(INICIA_BLOCO_COMANDOS); /* Início do bloco de comandos do ELSE */
+        if (pm->token == INICIA_BLOCO_COMANDOS) {
+          match(pm,INICIA_BLOCO_COMANDOS); /* Início do bloco de comandos do ELSE */
           if (t != NULL) {
-              t->child[2] = stmt_sequence(); /* Monta nó com sequência de declarações do ELSE */
+              t->child[2] = stmt_sequence(pm); /* Monta nó com sequência de declarações do ELSE */
           }
-          match(FECHA_BLOCO_COMANDOS); /* Fecha bloco de comandos do ELSE */
-        } else if (token == SE) {
+          match(pm,FECHA_BLOCO_COMANDOS); /* Fecha bloco de comandos do ELSE */
+        } else if (pm->token == SE) {
           /* Aqui tratamos um 'se' aninhado logo após o 'entao' */
           if (t != NULL) {
-            t->child[1] = if_stmt(); /* Chama if_stmt() recursivamente para o 'se' aninhado */
+            t->child[1] = if_stmt(pm); /* Chama if_stmt() recursivamente para o 'se' aninhado */
           }
         }else {
             if (t != NULL) {
-                t->child[2] = statement(); /* Monta nó com uma única declaração no ELSE */
-                match(SEPARADOR_COMANDO);
+                t->child[2] = statement(pm); /* Monta nó com uma única declaração no ELSE */
+                match(pm,SEPARADOR_COMANDO);
             }
         }
     }
@@ -236,29 +252,27 @@ TreeNode *if_stmt(void) {
 
 /* while-decl -> enquanto exp bloco-comandos */
 /* comando-sequencia -> stmt { SEPARADOR_COMANDO stmt } */
-TreeNode *while_stmt(void) {
-  TreeNode *t = newStmtNode(WhileK);
+TreeNode *while_stmt(PmCompiler * pm) {
+  TreeNode *t = newStmtNode(pm,WhileK);
   
   // Verificar se o token atual é 'ENQUANTO'
-  if (token == ENQUANTO) {
-    t->attr.name = copyString(tokenString);
-    match(ENQUANTO);
-  }
+  if (pm->token == ENQUANTO)
+    match(pm,ENQUANTO);
 
   // Construir a expressão condicional do while
   if (t != NULL)
-    t->child[0] = expr(); 
+    t->child[0] = expr(pm); 
 
   // Verificar se é uma sequência de comandos ou um comando único
-  if (token == INICIA_BLOCO_COMANDOS) {
-    match(INICIA_BLOCO_COMANDOS);
+  if (pm->token == INICIA_BLOCO_COMANDOS) {
+    match(pm,INICIA_BLOCO_COMANDOS);
     if (t != NULL)
-      t->child[1] = stmt_sequence();
-    match(FECHA_BLOCO_COMANDOS);
+      t->child[1] = stmt_sequence(pm);
+    match(pm,FECHA_BLOCO_COMANDOS);
   } else {
     // Se não for um bloco, aceitar apenas um comando simples
     if (t != NULL)
-      t->child[1] = statement();
+      t->child[1] = statement(pm);
   }
 
   return t;
@@ -266,170 +280,146 @@ TreeNode *while_stmt(void) {
 
 /* Avalia declaracao de repeticao (REPEAT) */
 /* repet-decl -> repita decl-sequencia ate exp */
-TreeNode *repeat_stmt(void) {
-  TreeNode *t = newStmtNode(RepeatK); /* Aloca no de declaracao IF */
-  if(token==REPITA) {
-    t->attr.name = copyString(tokenString);
-    match(REPITA); /* Captura IF */
-  }
-  if(token==INICIA_BLOCO_COMANDOS) {
-    match(INICIA_BLOCO_COMANDOS);
+TreeNode *repeat_stmt(PmCompiler * pm) {
+  TreeNode *t = newStmtNode(pm,RepeatK); /* Aloca no de declaracao IF */
+  if(pm->token==REPITA)
+    match(pm,REPITA); /* Captura IF */
+  if(pm->token==INICIA_BLOCO_COMANDOS) {
+    match(pm,INICIA_BLOCO_COMANDOS);
   }
   if (t!=NULL)
-    t->child[0] = stmt_sequence(); /* Monta no com sequencia de declaracoes */
-  if(token==FECHA_BLOCO_COMANDOS) {
-    match(FECHA_BLOCO_COMANDOS);
+    t->child[0] = stmt_sequence(pm); /* Monta no com sequencia de declaracoes */
+  if(pm->token==FECHA_BLOCO_COMANDOS) {
+    match(pm,FECHA_BLOCO_COMANDOS);
   }
-  match(ATE); /* Captura THEN */
+  match(pm,ATE); /* Captura THEN */
   if (t != NULL)
-    t->child[1] = expr(); /* Monta no de expressao */
+    t->child[1] = expr(pm); /* Monta no de expressao */
   return t;
 }
 
 /* Avalia declaracao de atribuicao */
 /* atrib-decl -> identificador=exp; */
-TreeNode *assign_stmt(void) {
-  TreeNode *t = newStmtNode(AssignK); 
-  if ((t != NULL) && (token == IDENTIFICADOR))
-    t->attr.name = copyString(tokenString);
-  match(IDENTIFICADOR); 
-  match(ATRIBUICAO); 
+TreeNode *assign_stmt(PmCompiler * pm) {
+  TreeNode *t = newStmtNode(pm,AssignK); 
+  if ((t != NULL) && (pm->token == IDENTIFICADOR))
+    t->attr.id = internToken(pm);
+  match(pm,IDENTIFICADOR); 
+  match(pm,ATRIBUICAO); 
   if (t != NULL)
-    t->child[0] = expr();
+    t->child[0] = expr(pm);
   return t;
 }
 
 /* Avalia declaracao READ */
 /* read-decl -> ler(identificador); */
-TreeNode *read_stmt(void) {
-  TreeNode *t = newStmtNode(ReadK); 
-  if(token==LER) {
-    match(LER);
+TreeNode *read_stmt(PmCompiler * pm) {
+  TreeNode *t = newStmtNode(pm,ReadK); 
+  if(pm->token==LER) {
+    match(pm,LER);
   }
-  if(token == ABRE_BLOCO_EXPRESSAO)
-    match(ABRE_BLOCO_EXPRESSAO);
-  if ((t != NULL) && (token == IDENTIFICADOR))
-    t->attr.name = copyString(tokenString);
-    match(IDENTIFICADOR); 
-  match(FECHA_BLOCO_EXPRESSAO);
+  if(pm->token == ABRE_BLOCO_EXPRESSAO)
+    match(pm,ABRE_BLOCO_EXPRESSAO);
+  if ((t != NULL) && (pm->token == IDENTIFICADOR))
+    t->attr.id = internToken(pm);
+  match(pm,IDENTIFICADOR);
+  match(pm,FECHA_BLOCO_EXPRESSAO);
   return t;
 }
 
 /* Avalia declaracao WITE */
 /* write-decl -> mostrar(exp); */
-TreeNode *write_stmt(void) {
-  TreeNode *t = newStmtNode(WriteK); 
-  if ((t != NULL) && (token == IDENTIFICADOR))
-    t->attr.name = copyString(tokenString); 
-  match(MOSTRAR);
-  match(ABRE_BLOCO_EXPRESSAO);
+TreeNode *write_stmt(PmCompiler * pm) {
+  TreeNode *t = newStmtNode(pm,WriteK); 
+  if ((t != NULL) && (pm->token == IDENTIFICADOR))
+    t->attr.id = internToken(pm); 
+  match(pm,MOSTRAR);
+  match(pm,ABRE_BLOCO_EXPRESSAO);
   if (t != NULL)
-    t->child[0] = expr();
-  match(FECHA_BLOCO_EXPRESSAO);
+    t->child[0] = expr(pm);
+  match(pm,FECHA_BLOCO_EXPRESSAO);
   return t;
 }
 
-/* Avalia expressao */
-/* exp -> simples-exp [ comparacao-op simples-exp ] */
-TreeNode *expr(void) {
-  TreeNode *t = simple_exp(); 
-  if ((token == MAIOR_QUE) || (token == MAIOR_QUE_IGUAL) || 
-  (token == MENOR_QUE) || (token == MENOR_QUE_IGUAL) ||
-  (token == IGUAL) || (token == NAO_IGUAL) ||
-  (token == E) || (token == OU)
-  ) {
-    TreeNode *p = newExpNode(OpK);
-    if (p != NULL) {
-      p->child[0] = t;
-      p->attr.op = token;
-      t = p;
-    }
-    match(token); 
-    if (t != NULL)
-      t->child[1] = simple_exp();
-  }
-  return t;
-}
+/* Forca de ligacao dos operadores binarios, indexada pelo token. Os
+   tokens que nao sao operadores binarios ficam com 0. Todos os
+   operadores associam a esquerda. */
+static const unsigned char bindingPower[ERROR + 1] = {
+  [OU] = 1,
+  [E] = 2,
+  [IGUAL] = 3, [NAO_IGUAL] = 3,
+  [MENOR_QUE] = 4, [MENOR_QUE_IGUAL] = 4, [MAIOR_QUE] = 4, [MAIOR_QUE_IGUAL] = 4,
+  [MAIS] = 5, [MENOS] = 5,
+  [VEZES] = 6, [SOBRE] = 6
+};
 
-/* Avalia expressao simples */
-/* simples-exp -> termo { soma termo } */
-TreeNode *simple_exp(void) {
-  TreeNode *t = term();
-  while ((token == MAIS) || (token == MENOS) ||
-  (token == MAIOR_QUE) || (token == MAIOR_QUE_IGUAL) || 
-  (token == MENOR_QUE) || (token == MENOR_QUE_IGUAL) ||
-  (token == IGUAL) || (token == NAO_IGUAL) ||
-  (token == E) || (token == OU)) {
-    TreeNode *p = newExpNode(OpK); 
-    if (p!=NULL) {
-      p->child[0] = t;
-      p->attr.op = token;
-      t = p;
-      match(token); 
-      t->child[1] = term();
-    }
+/* Avalia expressao por precedencia: a partir do operando esquerdo t,
+   agrupa os operadores com forca maior que minPower. O operando direito
+   de um operador so leva os operadores mais fortes que ele, entao a
+   recursao acontece apenas quando a precedencia sobe; uma sequencia de
+   operadores de mesma forca eh montada no laco. */
+/* exp -> fator { op-binario fator } */
+static TreeNode * binary_exp(PmCompiler * pm, TreeNode * t, int minPower) {
+  int power;
+  while ((power = bindingPower[pm->token]) > minPower) {
+    TreeNode * p = newExpNode(pm,OpK);
+    TreeNode * right;
+    if (p == NULL)
+      break;
+    p->child[0] = t;
+    p->attr.op = pm->token;
+    advance(pm);
+    right = factor(pm);
+    if (bindingPower[pm->token] > power)
+      right = binary_exp(pm,right,power);
+    p->child[1] = right;
+    t = p;
   }
   return t;
 }
 
-/* Avalia termo */
-/* termo -> fator { op fator } */
-TreeNode * term(void) {
-  TreeNode * t = factor(); // Obtenha o primeiro fator
-  while (token == VEZES || token == SOBRE ||
-  (token == MAIOR_QUE) || (token == MAIOR_QUE_IGUAL) || 
-  (token == MENOR_QUE) || (token == MENOR_QUE_IGUAL) ||
-  (token == IGUAL) || (token == NAO_IGUAL) ||
-  (token == E) || (token == OU)) { // Enquanto houver multiplicação ou divisão
-    TreeNode * p = newExpNode(OpK); // Cria um novo nó de operação
-    if (p != NULL) {
-      p->child[0] = t; // O filho esquerdo é o resultado anterior
-      p->attr.op = token; // A operação é o token atual
-      match(token); // Avança o token para o próximo
-      p->child[1] = factor(); // O filho direito é o próximo fator
-      t = p; // Atualiza t para ser o novo nó
-    }
-  }
-  return t; // Retorna a árvore construída
+/* Avalia expressao */
+TreeNode *expr(PmCompiler * pm) {
+  return binary_exp(pm,factor(pm),0);
 }
 
 /* Avalia fator */
 /* fator -> ( exp ) | numero | identificador  | ENDFILE */
-TreeNode * factor(void) {
+TreeNode * factor(PmCompiler * pm) {
   TreeNode * t = NULL;
-  switch (token) {
+  switch (pm->token) {
     case NUMERO_INTEIRO: /* fator -> numero */
-      t = newExpNode(ConstK); 
-      if ((t != NULL) && (token == NUMERO_INTEIRO))
-        t->attr.val.vint = atoi(tokenString);
+      t = newExpNode(pm,ConstK); 
+      if ((t != NULL) && (pm->token == NUMERO_INTEIRO))
+        t->attr.val.vint = pm->tokens.value[pm->pos].vint; /* ja convertido pela varredura */
       t->type = Integer;
-      match(NUMERO_INTEIRO); 
+      match(pm,NUMERO_INTEIRO); 
       break;
     case NUMERO_REAL:
-      t = newExpNode(ConstK);
-      if((t != NULL) && (token == NUMERO_REAL))
-        t->attr.val.vreal = atof(tokenString);
+      t = newExpNode(pm,ConstK);
+      if((t != NULL) && (pm->token == NUMERO_REAL))
+        t->attr.val.vreal = pm->tokens.value[pm->pos].vreal;
       t->type = Real;
-      match(NUMERO_REAL);
+      match(pm,NUMERO_REAL);
       break;
     case IDENTIFICADOR: 
-      t = newExpNode(IdK);
-      if ((t != NULL) && (token == IDENTIFICADOR))
-        t->attr.name = copyString(tokenString); 
-      match(IDENTIFICADOR); 
+      t = newExpNode(pm,IdK);
+      if ((t != NULL) && (pm->token == IDENTIFICADOR))
+        t->attr.id = internToken(pm); 
+      match(pm,IDENTIFICADOR); 
       break;
     case ABRE_BLOCO_EXPRESSAO: 
-      match(ABRE_BLOCO_EXPRESSAO); 
-      t = expr();
-      match(FECHA_BLOCO_EXPRESSAO); 
+      match(pm,ABRE_BLOCO_EXPRESSAO); 
+      t = expr(pm);
+      match(pm,FECHA_BLOCO_EXPRESSAO); 
       break;
     case ENDFILE: 
-      token = getToken();
+      advance(pm);
       break; // O programa so terminou, entao, nao imprime nenhum erro
     default:
-      syntaxError("unexpected token -> ");
-      printToken(token,tokenString);
-      token = getToken();
+      syntaxError(pm,"unexpected token -> ");
+      printToken(pm,pm->token,LEXEME,LEXLEN);
+      advance(pm);
       break;
     }
   return t;
@@ -439,12 +429,40 @@ TreeNode * factor(void) {
 /* Funcao principal do parser */
 /******************************/
 
-/* A funcao parse retorna a arvore sintatica construida */
-TreeNode * parse(void) {
+/* Posiciona o parser no primeiro token de pm->tokens */
+void parseStart(PmCompiler * pm) {
+  pm->pos = 0;
+  pm->token = (TokenType) pm->tokens.kind[0]; /* Captura primeiro token */
+  pm->lineno = pm->tokens.line[0];
+}
+
+/* Avalia um comando do nivel mais alto do programa */
+int parseTopStatement(PmCompiler * pm, TreeNode ** stmt) {
+  *stmt = statement(pm);
+  return sequence_next(pm);
+}
+
+/* Mostra o erro de um programa cuja sequencia de comandos termina antes
+   do fim do arquivo */
+void parseFinish(PmCompiler * pm) {
+  if (pm->token!=ENDFILE)
+    syntaxError(pm,"Code ends before file\n");
+}
+
+/* Monta a arvore sintatica a partir do fluxo de tokens ja varrido
+   para pm->tokens */
+TreeNode * parseTokens(PmCompiler * pm) {
   TreeNode * t;
-  token = getToken(); /* Captura primeiro token */
-  t = stmt_sequence(); /* Monta arvore sintatica */
-  if (token!=ENDFILE)
-    syntaxError("Code ends before file\n");
+  parseStart(pm);
+  t = stmt_sequence(pm); /* Monta arvore sintatica */
+  parseFinish(pm);
   return t;
 }
+
+/* A funcao parse varre o arquivo fonte inteiro e retorna a arvore
+   sintatica construida */
+TreeNode * parse(PmCompiler * pm) {
+  if (!scanAll(pm, &pm->tokens))
+    return NULL;
+  return parseTokens(pm);
+}
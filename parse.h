@@ -6,7 +6,24 @@
 #ifndef _PARSE_H_
 #define _PARSE_H_
 
-/* A funcao parse retorna a arvore sintatica construida */
-TreeNode * parse(void);
+/* A funcao parse varre o arquivo fonte inteiro e retorna a arvore
+   sintatica construida */
+TreeNode * parse(PmCompiler *);
+
+/* Monta a arvore sintatica a partir do fluxo de tokens que scanAll
+   deixou em pm->tokens, permitindo medir varredura e analise
+   separadamente */
+TreeNode * parseTokens(PmCompiler *);
+
+/* Passo a passo de parseTokens, para a reanalise incremental (incr.h).
+   parseStart posiciona o parser no primeiro token de pm->tokens.
+   parseTopStatement avalia em *stmt o proximo comando do nivel mais alto
+   (NULL se nao houver no) e consome o ';' que o separa do seguinte.
+   Retorna FALSE se a sequencia de comandos do programa termina depois
+   dele; parseFinish mostra entao o erro se ainda nao for o fim do
+   arquivo. */
+void parseStart(PmCompiler *);
+int parseTopStatement(PmCompiler *, TreeNode **);
+void parseFinish(PmCompiler *);
 
 #endif
@@ -0,0 +1,53 @@
+/****************************************************/
+/* File: pass.c                                     */
+/* Pass manager for the P- compiler                 */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "pass.h"
+#include "compiler.h"
+
+/* Esvazia o gerenciador */
+void initPasses(PassManager * pmgr) {
+  pmgr->count = 0;
+}
+
+/* Registra uma passada. Como uma passada so pode depender das que foram
+   registradas antes, as dependencias nunca formam ciclos. */
+int addPass(PassManager * pmgr, const Pass * p) {
+  if (pmgr->count == MAXPASSES || (p->needs & ~(PASS_BIT(pmgr->count) - 1)) != 0)
+    return -1;
+  pmgr->pass[pmgr->count] = *p;
+  return pmgr->count++;
+}
+
+/* Executa as passadas, fundindo num percurso todas as que estao prontas */
+int runPasses(PmCompiler * pm, PassManager * pmgr, TreeNode * t) {
+  unsigned int done = 0, all = PASS_BIT(pmgr->count) - 1;
+  int walks = 0;
+  while (done != all) {
+    TreeVisitor pre[MAXPASSES], post[MAXPASSES];
+    int group[MAXPASSES];
+    int i, npre = 0, npost = 0, n = 0;
+    /* as passadas que faltam e cujas dependencias ja terminaram */
+    for (i = 0; i < pmgr->count; i++) {
+      Pass * p = &pmgr->pass[i];
+      if ((done & PASS_BIT(i)) || (p->needs & ~done) != 0)
+        continue;
+      group[n++] = i;
+      if (p->preProc != NULL) pre[npre++] = p->preProc;
+      if (p->postProc != NULL) post[npost++] = p->postProc;
+    }
+    if (npre > 0 || npost > 0) {
+      walkTreeN(pm, t, pre, npre, post, npost);
+      walks++;
+    }
+    for (i = 0; i < n; i++) {
+      if (pmgr->pass[group[i]].finish != NULL)
+        pmgr->pass[group[i]].finish(pm);
+      done |= PASS_BIT(group[i]);
+    }
+  }
+  return walks;
+}
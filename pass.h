@@ -0,0 +1,46 @@
+/****************************************************/
+/* File: pass.h                                     */
+/* Pass manager for the P- compiler                 */
+/****************************************************/
+
+#ifndef _PASS_H_
+#define _PASS_H_
+
+/* Quantidade maxima de passadas num PassManager */
+#define MAXPASSES 16
+
+/* Uma passada sobre a arvore sintatica: preProc eh chamada em pre-ordem
+   e postProc em pos-ordem (qualquer uma pode ser NULL). finish, se nao
+   for NULL, roda depois do percurso, por exemplo para imprimir o
+   resultado. needs tem um bit para cada passada (pelo indice devolvido
+   por addPass) que precisa ter terminado antes desta comecar. */
+typedef struct {
+  const char * name;
+  TreeVisitor preProc;
+  TreeVisitor postProc;
+  void (* finish) (PmCompiler *);
+  unsigned int needs;
+} Pass;
+
+#define PASS_BIT(index) (1u << (index))
+
+typedef struct {
+  Pass pass[MAXPASSES];
+  int count;
+} PassManager;
+
+/* Esvazia o gerenciador */
+void initPasses(PassManager *);
+
+/* Registra uma passada e retorna o seu indice, ou -1 se nao houver
+   espaco ou se needs citar uma passada ainda nao registrada */
+int addPass(PassManager *, const Pass *);
+
+/* Executa as passadas registradas sobre a arvore. As passadas cujas
+   dependencias ja terminaram sao fundidas num unico percurso, em que as
+   visitas de cada no sao chamadas na ordem de registro; depois do
+   percurso as funcoes finish rodam na mesma ordem. Retorna o numero de
+   percursos feitos. */
+int runPasses(PmCompiler *, PassManager *, TreeNode *);
+
+#endif
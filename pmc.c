@@ -0,0 +1,441 @@
+/****************************************************/
+/* File: pmc.c                                      */
+/* Driver do compilador P- para varios arquivos     */
+/* Uso: pmc [-j threads] [-o dir] [-l lista] [-t]   */
+/*          [-a] [-p threads] [-c] [-d]             */
+/*          arquivos... ("-" = entrada padrao)      */
+/****************************************************/
+
+/* Cada arquivo eh compilado com o seu proprio PmCompiler por um pool
+   de threads. Os arquivos sao repartidos entre as filas das threads e
+   uma thread sem trabalho rouba da fila das outras, de modo que
+   arquivos de tamanhos muito diferentes nao deixam cores ociosos.
+   A listagem de arquivo.pm vai para arquivo.lst (ou para dir/ com -o)
+   e no final eh impresso um resumo dos arquivos com erro. O arquivo "-"
+   eh a entrada padrao, varrida em modo de fluxo enquanto o produtor
+   ainda escreve (gerador | pmc -), com listagem em stdin.lst.
+   Com -a a arvore compacta (ast.h) de cada fonte sem erros sintaticos
+   eh gravada em arquivo.ast, junto da listagem. Enquanto o tamanho e a
+   data de modificacao do fonte (em nanossegundos, onde o sistema de
+   arquivos a guarda) forem os mesmos, as compilacoes seguintes
+   mapeiam essa arvore e fazem a analise semantica direto nela, sem
+   varrer nem analisar o fonte. Se o primeiro percurso achar um no
+   invalido, o fonte eh analisado e o arquivo, regravado.
+   Com -p cada fonte grande eh dividido em pedacos analisados em
+   paralelo (pparse.h), para os programas enormes em que um unico
+   arquivo ocuparia um so core.
+   Com -c o bytecode (code.h) de cada fonte sem erros eh gravado em
+   arquivo.pmb, e com -d ele eh mostrado na listagem. O gerador precisa
+   da arvore de ponteiros, entao com -c ou -d a arvore gravada por -a
+   nao eh reaproveitada (mas continua sendo gravada). */
+
+#include "util.c"
+#include "intern.c"
+#include "pass.c"
+#include "ast.c"
+#include "scan.c"
+#include "parse.c"
+#include "pparse.c"
+#include "symtab.c"
+#include "analyze.c"
+#include "compiler.c"
+#include "cgen.c"
+
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <glob.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = TRUE;
+int TraceCode = FALSE;
+
+/* Situacao de cada arquivo ao final da compilacao */
+typedef enum {PENDENTE, COMPILADO, COM_ERRO, SEM_ACESSO} FileStatus;
+
+typedef struct {
+    char *name;
+    FileStatus status;
+} SourceFile;
+
+static SourceFile *files;
+static int nfiles, filesCapacity;
+static const char *outDir = NULL;
+static int cacheAst = FALSE;
+static int parseThreads = 1;
+static int genCode = FALSE;
+
+/* Fila de uma thread: o dono retira do fim, os ladroes do inicio.
+   Nenhum trabalho novo eh criado durante a compilacao, entao quando
+   todas as filas estao vazias o pool terminou. */
+typedef struct {
+    pthread_mutex_t lock;
+    int *jobs; /* indices em files */
+    int top, bottom; /* jobs[top..bottom-1] ainda nao foram retirados */
+    int stolen; /* quantos trabalhos esta thread roubou */
+} WorkQueue;
+
+static WorkQueue *queues;
+static int nthreads;
+
+static void addFile(const char *name) {
+    if (nfiles == filesCapacity) {
+        filesCapacity = filesCapacity ? 2 * filesCapacity : 256;
+        files = realloc(files, filesCapacity * sizeof(SourceFile));
+        if (files == NULL) {
+            fprintf(stderr, "Out of memory error reading file names\n");
+            exit(1);
+        }
+    }
+    files[nfiles].name = strdup(name);
+    files[nfiles].status = PENDENTE;
+    nfiles++;
+}
+
+/* Acrescenta os arquivos que casam com o padrao. Um padrao que nao
+   casa com nada eh mantido literalmente e acusado como sem acesso. */
+static void addPattern(const char *pattern) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE h;
+    const char *slash = strrchr(pattern, '\\');
+    const char *fwd = strrchr(pattern, '/');
+    int dirLen;
+    char path[MAX_PATH * 2];
+    if (fwd > slash) slash = fwd;
+    dirLen = slash ? (int) (slash - pattern + 1) : 0;
+    if ((h = FindFirstFileA(pattern, &fd)) == INVALID_HANDLE_VALUE) {
+        addFile(pattern);
+        return;
+    }
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        snprintf(path, sizeof(path), "%.*s%s", dirLen, pattern, fd.cFileName);
+        addFile(path);
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    glob_t g;
+    size_t i;
+    if (glob(pattern, GLOB_NOCHECK, NULL, &g) != 0) {
+        addFile(pattern);
+        return;
+    }
+    for (i = 0; i < g.gl_pathc; i++)
+        addFile(g.gl_pathv[i]);
+    globfree(&g);
+#endif
+}
+
+/* Le uma lista de arquivos (ou padroes), um por linha. "-" eh a
+   entrada padrao. */
+static void addList(const char *listName) {
+    char line[4096];
+    FILE *f = strcmp(listName, "-") == 0 ? stdin : fopen(listName, "r");
+    if (f == NULL) {
+        perror(listName);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        size_t n = strcspn(line, "\r\n");
+        line[n] = '\0';
+        if (n > 0) addPattern(line);
+    }
+    if (f != stdin) fclose(f);
+}
+
+/* Nome da listagem: a extensao do fonte eh trocada por ext (".lst"
+   ou ".ast") e, com -o, o diretorio do fonte pelo diretorio de saida */
+static void outputName(const char *src, const char *ext, char *out, size_t size) {
+    const char *base, *p, *dot;
+    if (strcmp(src, "-") == 0) src = "stdin";
+    base = src;
+    for (p = src; *p; p++)
+        if (*p == '/' || *p == '\\') base = p + 1;
+    dot = strrchr(base, '.');
+    if (dot == NULL) dot = base + strlen(base);
+    if (outDir != NULL)
+        snprintf(out, size, "%s/%.*s%s", outDir, (int) (dot - base), base, ext);
+    else
+        snprintf(out, size, "%.*s%s", (int) (dot - src), src, ext);
+}
+
+/* Data de modificacao do fonte em nanossegundos, guardada no .ast. So
+   com os segundos, uma edicao que mantivesse o tamanho e caisse no mesmo
+   segundo da compilacao anterior reaproveitaria a arvore antiga. */
+static long long sourceTime(const struct stat *st) {
+#if defined(_WIN32)
+    return (long long) st->st_mtime * 1000000000LL;
+#elif defined(__APPLE__)
+    return (long long) st->st_mtimespec.tv_sec * 1000000000LL + st->st_mtimespec.tv_nsec;
+#else
+    return (long long) st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+#endif
+}
+
+/* Compila um arquivo com o contexto da thread */
+static FileStatus compileFile(PmCompiler *pm, const char *name) {
+    char lst[4096], astName[4096], codeName[4096];
+    struct stat st;
+    AstTree a;
+    TreeNode *t;
+    FileStatus status;
+    int stamped, mapped;
+
+    outputName(name, ".lst", lst, sizeof(lst));
+    outputName(name, ".ast", astName, sizeof(astName));
+    outputName(name, ".pmb", codeName, sizeof(codeName));
+    memset(&a, 0, sizeof(a));
+    stamped = cacheAst && strcmp(name, "-") != 0 && stat(name, &st) == 0;
+    mapped = stamped && !genCode && !TraceCode &&
+             astMap(pm, &a, astName, (long long) st.st_size, sourceTime(&st));
+    if (mapped) {
+        /* Fonte inalterado: a analise semantica eh feita na arvore gravada */
+        if ((pm->listing = fopen(lst, "w")) == NULL) {
+            freeAst(&a);
+            resetCompiler(pm);
+            return SEM_ACESSO;
+        }
+        if (TraceParse) {
+            fprintf(pm->listing, "\nSyntax tree:\n");
+            mapped = printAst(pm, &a);
+        }
+        mapped = mapped && buildSymtabAst(pm, &a) && typeCheckAst(pm, &a);
+        if (!mapped) {
+            /* Os nos do arquivo sao invalidos (o primeiro percurso os
+               confere): a listagem eh descartada e o fonte, analisado */
+            fclose(pm->listing);
+            freeAst(&a);
+            resetCompiler(pm);
+        }
+    }
+    if (!mapped) {
+        if (strcmp(name, "-") == 0)
+            pm->source = stdin;
+        else if ((pm->source = fopen(name, "r")) == NULL) {
+            resetCompiler(pm);
+            return SEM_ACESSO;
+        }
+        if ((pm->listing = fopen(lst, "w")) == NULL) {
+            if (pm->source != stdin) fclose(pm->source);
+            resetCompiler(pm);
+            return SEM_ACESSO;
+        }
+        /* scanOpen pode falhar depois de alocar o buffer de fluxo */
+        if (!scanOpen(pm, pm->source)) {
+            if (pm->source != stdin) fclose(pm->source);
+            fclose(pm->listing);
+            resetCompiler(pm);
+            return SEM_ACESSO;
+        }
+
+        t = parseParallel(pm, parseThreads);
+        /* A arvore eh gravada antes que a analise altere os tipos */
+        if (stamped && !pm->error && flattenTree(pm, t, &a))
+            astWrite(pm, &a, astName, (long long) st.st_size, sourceTime(&st));
+        if (TraceParse) {
+            fprintf(pm->listing, "\nSyntax tree:\n");
+            printTree(pm, t);
+        }
+        /* Como no TINY, um erro sintatico previne as passadas seguintes */
+        if (!pm->error)
+            analyze(pm, t);
+        if (!pm->error && (genCode || TraceCode)) {
+            if (genCode && (pm->code = fopen(codeName, "wb")) == NULL) {
+                fprintf(pm->listing, "Nao foi possivel gravar %s\n", codeName);
+                pm->error = TRUE;
+            } else {
+                codeGen(pm, t);
+                if (pm->code != NULL && fclose(pm->code) != 0)
+                    pm->error = TRUE;
+                if (pm->code != NULL && pm->error)
+                    remove(codeName);
+                pm->code = NULL;
+            }
+        }
+        if (pm->source != stdin) fclose(pm->source);
+    }
+    status = pm->error ? COM_ERRO : COMPILADO;
+
+    fclose(pm->listing);
+    freeAst(&a);
+    resetCompiler(pm);
+    return status;
+}
+
+/* Retira um trabalho da fila q, pelo fim se for o dono */
+static int takeJob(WorkQueue *q, int owner) {
+    int job = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->top < q->bottom)
+        job = owner ? q->jobs[--q->bottom] : q->jobs[q->top++];
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+static void *worker(void *arg) {
+    int self = (int) (size_t) arg, job, i;
+    PmCompiler *pm = newCompiler();
+    if (pm == NULL) return NULL;
+    for (;;) {
+        job = takeJob(&queues[self], TRUE);
+        /* Fila vazia: tenta roubar das outras threads */
+        for (i = 1; job < 0 && i < nthreads; i++)
+            if ((job = takeJob(&queues[(self + i) % nthreads], FALSE)) >= 0)
+                queues[self].stolen++;
+        if (job < 0) break;
+        files[job].status = compileFile(pm, files[job].name);
+    }
+    freeCompiler(pm);
+    return NULL;
+}
+
+static int coreCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int) si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#endif
+}
+
+/* Relogio de parede em segundos */
+static double now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double) c.QuadPart / (double) f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-j threads] [-o dir] [-l lista] [-t] [-a] [-p threads] [-c] [-d]\n"
+        "          arquivos...\n"
+        "  -j N     numero de threads (padrao: numero de cores)\n"
+        "  -o dir   grava as listagens em dir\n"
+        "  -l lista le nomes ou padroes de arquivo da lista (- = stdin)\n"
+        "  -        compila a entrada padrao (listagem em stdin.lst)\n"
+        "  -t       imprime a arvore sintatica na listagem\n"
+        "  -a       grava a arvore de cada fonte em .ast e a reaproveita\n"
+        "           enquanto o fonte nao mudar\n"
+        "  -p N     analisa cada fonte em ate N pedacos em paralelo\n"
+        "  -c       grava o bytecode de cada fonte em .pmb\n"
+        "  -d       mostra o bytecode na listagem\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t *threads;
+    int i, j, errors = 0, missing = 0, stolen = 0;
+    double t0, secs;
+
+    nthreads = coreCount();
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            nthreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outDir = argv[++i];
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            addList(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0)
+            TraceParse = TRUE;
+        else if (strcmp(argv[i], "-a") == 0)
+            cacheAst = TRUE;
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            parseThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0)
+            genCode = TRUE;
+        else if (strcmp(argv[i], "-d") == 0)
+            TraceCode = TRUE;
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+            usage(argv[0]);
+        else
+            addPattern(argv[i]);
+    }
+    if (nfiles == 0) usage(argv[0]);
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > nfiles) nthreads = nfiles;
+
+    /* Reparte os arquivos em blocos contiguos, um por thread */
+    queues = calloc(nthreads, sizeof(WorkQueue));
+    threads = malloc(nthreads * sizeof(pthread_t));
+    if (queues == NULL || threads == NULL) {
+        fprintf(stderr, "Out of memory error creating threads\n");
+        return 1;
+    }
+    for (i = 0; i < nthreads; i++) {
+        int first = (int) ((long long) nfiles * i / nthreads);
+        int last = (int) ((long long) nfiles * (i + 1) / nthreads);
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].jobs = malloc((last - first) * sizeof(int) + 1);
+        if (queues[i].jobs == NULL) {
+            fprintf(stderr, "Out of memory error creating threads\n");
+            return 1;
+        }
+        /* O dono retira do fim: guarda o bloco invertido para compilar
+           os arquivos na ordem em que foram dados */
+        for (j = first; j < last; j++)
+            queues[i].jobs[last - 1 - j] = j;
+        queues[i].bottom = last - first;
+    }
+
+    t0 = now();
+    for (i = 0; i < nthreads; i++)
+        if (pthread_create(&threads[i], NULL, worker, (void *) (size_t) i) != 0) {
+            fprintf(stderr, "Erro ao criar thread\n");
+            return 1;
+        }
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    secs = now() - t0;
+
+    /* Resumo */
+    for (i = 0; i < nfiles; i++) {
+        char lst[4096];
+        switch (files[i].status) {
+            case COM_ERRO:
+                outputName(files[i].name, ".lst", lst, sizeof(lst));
+                printf("%s: erro de compilacao (veja %s)\n", files[i].name, lst);
+                errors++;
+                break;
+            case SEM_ACESSO:
+            case PENDENTE:
+                printf("%s: nao foi possivel abrir o arquivo ou a listagem\n",
+                       files[i].name);
+                missing++;
+                break;
+            default:
+                break;
+        }
+    }
+    for (i = 0; i < nthreads; i++) {
+        stolen += queues[i].stolen;
+        pthread_mutex_destroy(&queues[i].lock);
+        free(queues[i].jobs);
+    }
+    printf("%d arquivos, %d com erro, %d sem acesso; %d threads, "
+           "%d roubos, %.3f s (%.0f arquivos/s)\n",
+           nfiles, errors, missing, nthreads, stolen, secs,
+           secs > 0 ? nfiles / secs : 0.0);
+
+    for (i = 0; i < nfiles; i++)
+        free(files[i].name);
+    free(files);
+    free(queues);
+    free(threads);
+    return (errors || missing) ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/****************************************************/
+/* File: pmi.c                                      */
+/* Interpretador do bytecode do P-                  */
+/* Uso: pmi [-s] [-b repeticoes] programa           */
+/****************************************************/
+
+/* programa eh um arquivo de codigo gravado por pmc -c (.pmb) ou um
+   fonte P-, que eh compilado na memoria antes da execucao (a listagem
+   da compilacao vai para a saida de erro). ler le numeros da entrada
+   padrao e mostrar escreve na saida padrao, um valor por linha. As
+   instrucoes sao despachadas por goto computado (vm.h); -s usa o laco
+   com switch.
+   Com -b o programa eh executado repeticoes vezes com cada despacho,
+   sempre com a mesma entrada (a entrada padrao, copiada antes para um
+   arquivo temporario) e com a saida descartada. Vale o melhor tempo de
+   cada despacho, mostrado com as instrucoes executadas por segundo e o
+   ganho do goto computado sobre o switch. Os programas de teste podem
+   ser gerados com gerapm -x. */
+
+#include "util.c"
+#include "intern.c"
+#include "pass.c"
+#include "ast.c"
+#include "scan.c"
+#include "parse.c"
+#include "symtab.c"
+#include "analyze.c"
+#include "compiler.c"
+#include "cgen.c"
+#include "vm.c"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+
+/* Relogio de parede em segundos */
+static double now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double) c.QuadPart / (double) f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-s] [-b repeticoes] programa\n"
+        "  programa  arquivo .pmb (pmc -c) ou fonte P-\n"
+        "  -s        despacha as instrucoes com switch\n"
+        "  -b N      mede N execucoes com cada despacho\n", prog);
+    exit(1);
+}
+
+/* Carrega o programa em m: o modulo gravado ou o codigo gerado pela
+   compilacao do fonte em pm. Retorna o modulo, ou NULL com a mensagem
+   ja mostrada. */
+static const CodeModule *loadProgram(PmCompiler *pm, const char *fileName, CodeModule *m) {
+    char magic[8];
+    TreeNode *t;
+    FILE *f = fopen(fileName, "rb");
+    if (f == NULL) {
+        perror(fileName);
+        return NULL;
+    }
+    if (fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, CODE_MAGIC, sizeof(magic)) == 0) {
+        rewind(f);
+        if (!loadCode(m, f)) {
+            fprintf(stderr, "%s: arquivo de codigo invalido ou de outra versao\n", fileName);
+            fclose(f);
+            return NULL;
+        }
+        fclose(f);
+        return m;
+    }
+    fclose(f);
+    pm->listing = stderr;
+    if ((pm->source = fopen(fileName, "r")) == NULL || !scanOpen(pm, pm->source)) {
+        perror(fileName);
+        return NULL;
+    }
+    t = parse(pm);
+    if (!pm->error)
+        analyze(pm, t);
+    if (!pm->error)
+        codeGen(pm, t);
+    fclose(pm->source);
+    if (pm->error) {
+        fprintf(stderr, "%s: erro de compilacao\n", fileName);
+        return NULL;
+    }
+    return &pm->module;
+}
+
+/* Mede as execucoes com cada despacho (-b) */
+static int benchRun(const char *fileName, const CodeModule *m, int reps) {
+    static const char *dispatchName[2] = {"goto", "switch"};
+    double best[2] = {0, 0};
+    long long steps[2] = {0, 0};
+    FILE *in = tmpfile(), *out = fopen(NULL_FILE, "w");
+    char buf[4096];
+    size_t n;
+    int d, r;
+    if (in == NULL || out == NULL) {
+        fprintf(stderr, "Nao foi possivel criar os arquivos da medicao\n");
+        return FALSE;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+        fwrite(buf, 1, n, in);
+    for (r = 0; r < reps; r++)
+        for (d = VM_THREADED; d <= VM_SWITCH; d++) {
+            double t0;
+            rewind(in);
+            t0 = now();
+            if (!runCode(m, in, out, (VmDispatch) d, &steps[d]))
+                return FALSE;
+            t0 = now() - t0;
+            if (r == 0 || t0 < best[d]) best[d] = t0;
+        }
+    printf("%s: %lld instrucoes por execucao, %d palavras de codigo\n",
+           fileName, steps[VM_THREADED], m->ncode);
+    for (d = VM_THREADED; d <= VM_SWITCH; d++)
+        printf("  %-8s %9.4f s %10.1f Minstr/s\n", dispatchName[d], best[d],
+               best[d] > 0 ? steps[d] / best[d] / 1e6 : 0.0);
+    if (best[VM_THREADED] > 0)
+        printf("  goto/switch %.2fx\n", best[VM_SWITCH] / best[VM_THREADED]);
+    fclose(in);
+    fclose(out);
+    return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+    VmDispatch dispatch = VM_THREADED;
+    const char *fileName = NULL;
+    const CodeModule *program;
+    CodeModule loaded;
+    PmCompiler *pm;
+    int reps = 0, ok, i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0)
+            dispatch = VM_SWITCH;
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            reps = atoi(argv[++i]);
+        else if (argv[i][0] == '-' || fileName != NULL)
+            usage(argv[0]);
+        else
+            fileName = argv[i];
+    }
+    if (fileName == NULL) usage(argv[0]);
+    if ((pm = newCompiler()) == NULL) return 1;
+    memset(&loaded, 0, sizeof(loaded));
+    if ((program = loadProgram(pm, fileName, &loaded)) == NULL) {
+        freeCompiler(pm);
+        return 1;
+    }
+    if (reps > 0)
+        ok = benchRun(fileName, program, reps);
+    else
+        ok = runCode(program, stdin, stdout, dispatch, NULL);
+    freeCode(&loaded);
+    freeCompiler(pm);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/****************************************************/
+/* File: pparse.c                                   */
+/* Parallel parsing for the P- compiler             */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "scan.h"
+#include "parse.h"
+#include "intern.h"
+#include "pparse.h"
+#include "compiler.h"
+
+#include <pthread.h>
+
+/* Um pedaco do fonte: [from, to). Ele eh varrido a partir da linha 1,
+   e as linhas dos nos sao corrigidas depois, quando as dos pedacos
+   anteriores forem conhecidas. */
+typedef struct {
+  PmCompiler * pm; /* contexto do pedaco, em pm->parsers */
+  const char * text;
+  long from, to;
+  TreeNode * first, * last; /* primeiro e ultimo comando do pedaco */
+} Chunk;
+
+/* Caracteres que interessam a findCuts */
+static const unsigned char cutChar[256] = {['{'] = 1, ['}'] = 1, ['/'] = 1, [';'] = 1};
+
+/* Acha ate n - 1 cortes: o primeiro ';' fora de blocos e comentarios
+   depois de cada fracao size / n do texto. cuts[i] eh o deslocamento do
+   ';'. Retorna quantos achou. */
+static int findCuts(const char * text, long size, int n, long cuts[]) {
+  long i;
+  int depth = 0, k = 0;
+  for (i = 0; i < size && k < n - 1; i++) {
+    while (i < size && !cutChar[(unsigned char) text[i]])
+      i++;
+    if (i == size)
+      break;
+    switch (text[i]) {
+      case '{':
+        depth++;
+        break;
+      case '}':
+        depth--;
+        break;
+      case '/': /* comentario: pula ate o fechamento */
+        if (i + 1 < size && text[i+1] == '*') {
+          for (i += 2; i + 1 < size && !(text[i] == '*' && text[i+1] == '/'); i++)
+            ;
+          i++;
+        }
+        break;
+      default: /* ';' */
+        if (depth == 0 && i >= (k + 1) * (size / n))
+          cuts[k++] = i;
+        break;
+    }
+  }
+  return k;
+}
+
+/* Garante n contextos em pm->parsers, cada um com uma listagem
+   descartada para os erros, que sao mostrados de novo por parse */
+static int reserveParsers(PmCompiler * pm, int n) {
+  if (pm->parsers == NULL &&
+      (pm->parsers = (PmCompiler **) calloc(MAXPARSERS, sizeof(PmCompiler *))) == NULL)
+    return FALSE;
+  for (; pm->nparsers < n; pm->nparsers++) {
+    PmCompiler * w = newCompiler();
+    if (w == NULL)
+      return FALSE;
+    if ((w->quiet = fopen(NULL_FILE, "w")) == NULL) {
+      freeCompiler(w);
+      return FALSE;
+    }
+    w->listing = w->quiet;
+    pm->parsers[pm->nparsers] = w;
+  }
+  return TRUE;
+}
+
+/* Varre e analisa um pedaco. O texto eh o do contexto principal, entao
+   os deslocamentos dos tokens sao os mesmos. */
+static void * parseChunk(void * arg) {
+  Chunk * c = (Chunk *) arg;
+  PmCompiler * w = c->pm;
+  TreeNode * t;
+  w->sourceText = c->text;
+  w->sourceSize = c->to - c->from;
+  w->cur = c->text + c->from;
+  w->end = c->text + c->to;
+  w->lineno = 1;
+  w->error = FALSE;
+  c->first = c->last = NULL;
+  if (!scanAll(w, &w->tokens))
+    w->error = TRUE;
+  else
+    c->first = parseTokens(w);
+  /* o texto nao pertence a este contexto (scanClose o liberaria) */
+  w->sourceText = w->cur = w->end = NULL;
+  for (t = c->first; t != NULL; t = t->sibling)
+    c->last = t;
+  return NULL;
+}
+
+/* Visita que soma pm->lineShift a linha do no e troca o id do nome
+   pelo do contexto principal */
+static void remapNode(PmCompiler * pm, TreeNode * t) {
+  t->lineno += pm->lineShift;
+  if (((t->nodekind == StmtK && (t->kind.stmt == AssignK || t->kind.stmt == ReadK)) ||
+       (t->nodekind == ExpK && t->kind.exp == IdK)) && t->attr.id >= 0)
+    t->attr.id = pm->idMap[t->attr.id];
+}
+
+static void * remapChunk(void * arg) {
+  Chunk * c = (Chunk *) arg;
+  walkTree(c->pm, c->first, remapNode, NULL);
+  return NULL;
+}
+
+/* Executa fn para cada pedaco, o primeiro na thread corrente */
+static void runChunks(Chunk chunks[], int n, void * (* fn) (void *)) {
+  pthread_t threads[MAXPARSERS];
+  int started[MAXPARSERS], i;
+  for (i = 1; i < n; i++)
+    started[i] = pthread_create(&threads[i], NULL, fn, &chunks[i]) == 0;
+  fn(&chunks[0]);
+  for (i = 1; i < n; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      fn(&chunks[i]);
+  }
+}
+
+/* Insere os nomes do pedaco na tabela principal, na ordem dos ids do
+   pedaco, e monta idMap. Como os pedacos sao tratados na ordem do fonte,
+   os ids sao os da primeira ocorrencia, como em parse. Retorna -1 se
+   faltar memoria. */
+static int mapNames(PmCompiler * pm, PmCompiler * w) {
+  int n = internCount(w), i;
+  if (n > w->idMapCapacity) {
+    int * grown = (int *) realloc(w->idMap, n * sizeof(int));
+    if (grown == NULL)
+      return -1;
+    w->idMap = grown;
+    w->idMapCapacity = n;
+  }
+  for (i = 0; i < n; i++) {
+    const char * s = internString(w, i);
+    if ((w->idMap[i] = internName(pm, s, (int) strlen(s))) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+/* Analise sintatica em paralelo */
+TreeNode * parseParallel(PmCompiler * pm, int nthreads) {
+  Chunk chunks[MAXPARSERS];
+  long cuts[MAXPARSERS];
+  int n, line, ok, i;
+  TreeNode * root = NULL, * last = NULL;
+  if (nthreads > MAXPARSERS)
+    nthreads = MAXPARSERS;
+  if (pm->sourceSize / PARSE_MIN_CHUNK < nthreads)
+    nthreads = (int) (pm->sourceSize / PARSE_MIN_CHUNK);
+  if (nthreads < 2 || pm->sourceText == NULL || pm->streaming || EchoSource || TraceScan ||
+      pm->cur != pm->sourceText || internCount(pm) != 0)
+    return parse(pm);
+  n = findCuts(pm->sourceText, pm->sourceSize, nthreads, cuts) + 1;
+  if (n < 2 || !reserveParsers(pm, n))
+    return parse(pm);
+  for (i = 0; i < n; i++) {
+    chunks[i].pm = pm->parsers[i];
+    chunks[i].text = pm->sourceText;
+    chunks[i].from = (i > 0) ? cuts[i-1] + 1 : 0;
+    chunks[i].to = (i < n - 1) ? cuts[i] : pm->sourceSize;
+  }
+  runChunks(chunks, n, parseChunk);
+  for (ok = TRUE, i = 0; i < n; i++)
+    ok = ok && !chunks[i].pm->error;
+  /* ids dos nomes e primeira linha de cada pedaco; o primeiro ja
+     esta certo */
+  for (line = 1, i = 0; ok && i < n; i++) {
+    PmCompiler * w = chunks[i].pm;
+    ok = mapNames(pm, w) == 0;
+    w->lineShift = line - 1;
+    line += w->lineno - 1; /* quebras de linha do pedaco */
+  }
+  if (!ok) {
+    for (i = 0; i < n; i++)
+      resetCompiler(chunks[i].pm);
+    internClear(pm);
+    return parse(pm);
+  }
+  runChunks(chunks + 1, n - 1, remapChunk);
+  /* costura as sequencias de comandos na ordem do fonte */
+  for (i = 0; i < n; i++) {
+    if (chunks[i].first == NULL)
+      continue;
+    if (last == NULL)
+      root = chunks[i].first;
+    else
+      last->sibling = chunks[i].first;
+    last = chunks[i].last;
+  }
+  pm->cur = pm->end;
+  pm->lineno = line;
+  pm->token = ENDFILE;
+  return root;
+}
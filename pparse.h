@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: pparse.h                                   */
+/* Parallel parsing for the P- compiler             */
+/****************************************************/
+
+#ifndef _PPARSE_H_
+#define _PPARSE_H_
+
+/* Maior numero de pedacos em que um fonte eh dividido */
+#define MAXPARSERS 64
+
+/* Menor pedaco que vale uma thread */
+#ifndef PARSE_MIN_CHUNK
+#define PARSE_MIN_CHUNK (256 * 1024)
+#endif
+
+/* Como parse, mas divide o fonte em ate nthreads pedacos, varridos e
+   analisados ao mesmo tempo, cada um com o seu proprio contexto. Os
+   cortes sao feitos num ';' fora de blocos {...} e de comentarios, logo
+   depois de cada fracao do texto; os comandos de cada pedaco sao
+   encadeados na ordem do fonte, com as linhas e os ids de nomes que
+   parse daria. Se algum pedaco tiver erro (um ';' que nao separa
+   comandos do nivel mais alto, por exemplo dentro de repita...ate sem
+   chaves), o fonte inteiro eh analisado de novo por parse, para que a
+   arvore e as mensagens sejam as mesmas. O fonte deve estar inteiro na
+   memoria (scanOpen fora do modo de fluxo); senao, ou com EchoSource ou
+   TraceScan, parse eh chamada direto. Os nos ficam nas arenas dos
+   contextos dos pedacos, guardados em pm ate o proximo resetCompiler. */
+TreeNode * parseParallel(PmCompiler *, int nthreads);
+
+#endif
@@ -1,275 +1,686 @@
 #include "globals.h"
 #include "util.h"
 #include "scan.h"
+#include "compiler.h"
+
+#include <float.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* Modo de fluxo (pipes, stdin): a entrada eh lida em blocos de
+   STREAM_CHUNK bytes para um buffer circular de STREAM_RING blocos */
+#ifndef STREAM_CHUNK
+#define STREAM_CHUNK (64 * 1024)
+#endif
+#define STREAM_RING 4
+
+/* Caminhos vetoriais para pular brancos e comentarios. A largura eh escolhida
+   em tempo de compilacao (AVX2 com -mavx2, senao SSE2, que todo x86-64 tem);
+   sem nenhum dos dois so o laco escalar eh usado. */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VEC_BYTES 32
+#define VEC_ALL 0xffffffffu
+typedef __m256i Vec;
+#define VLOAD(p)   _mm256_loadu_si256((const __m256i *) (p))
+#define VSPLAT(c)  _mm256_set1_epi8(c)
+#define VEQ(a, b)  _mm256_cmpeq_epi8(a, b)
+#define VOR(a, b)  _mm256_or_si256(a, b)
+#define VMASK(a)   ((unsigned) _mm256_movemask_epi8(a))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VEC_BYTES 16
+#define VEC_ALL 0xffffu
+typedef __m128i Vec;
+#define VLOAD(p)   _mm_loadu_si128((const __m128i *) (p))
+#define VSPLAT(c)  _mm_set1_epi8(c)
+#define VEQ(a, b)  _mm_cmpeq_epi8(a, b)
+#define VOR(a, b)  _mm_or_si128(a, b)
+#define VMASK(a)   ((unsigned) _mm_movemask_epi8(a))
+#endif
+
+#ifdef VEC_BYTES
+#ifdef _MSC_VER
+#include <intrin.h>
+static int ctz32(unsigned x) { unsigned long i; _BitScanForward(&i, x); return (int) i; }
+#define popcount32(x) ((int) __popcnt(x))
+#else
+#define ctz32(x) __builtin_ctz(x)
+#define popcount32(x) __builtin_popcount(x)
+#endif
+#endif
 
 /* Estados do DFA para análise léxica */
 typedef enum {
-    START, INASSIGN, INNUM, INREAL, INID, DONE, INCOMMENT
+    S_START, S_NUM, S_REAL, S_ID, S_COLON, S_EQ, S_LT, S_GT, S_BANG,
+    S_SLASH, S_AMP, S_BAR, NSTATES
 } StateType;
 
-/* Lexema para identificador ou palavra reservada */
-char tokenString[MAXTOKENLEN+1];
-
-/* BUFLEN = tamanho do buffer de entrada para linhas do código fonte */
-#define BUFLEN 256
-
-static char lineBuf[BUFLEN]; /* Linha atual */
-static int linepos = 0; /* Posição em lineBuf */
-static int bufsize = 0; /* Tamanho atual da string no buffer */
-static int EOF_flag = FALSE; /* Corrige o comportamento de ungetNextChar no EOF */
-
-/* getNextChar pega o próximo caractere não branco de lineBuf, lendo uma nova linha se lineBuf estiver todo lido */
-static int getNextChar(void) {
-    if (!(linepos < bufsize)) {
-        lineno++;
-        if (fgets(lineBuf, BUFLEN-1, source)) {
-            if (EchoSource) fprintf(listing, "%4d: %s", lineno, lineBuf);
-            bufsize = strlen(lineBuf);
-            linepos = 0;
-            return lineBuf[linepos++];
-        } else {
-            EOF_flag = TRUE;
-            return EOF;
+/* Classes de caracteres. Cada byte da entrada eh mapeado para uma classe
+   por charClass; C_EOF representa o fim do texto */
+typedef enum {
+    C_OTHER, C_BLANK, C_NL, C_DIGIT, C_ALPHA, C_DOT, C_COLON, C_EQ, C_LT, C_GT,
+    C_BANG, C_SLASH, C_STAR, C_AMP, C_BAR, C_PLUS, C_MINUS, C_LPAR, C_RPAR,
+    C_LBRC, C_RBRC, C_SEMI, C_COMMA, C_EOF, NCLASSES
+} CharClass;
+
+static const unsigned char charClass[256] = {
+    C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  /*   0-  7 */
+    C_OTHER,  C_BLANK,  C_NL,     C_OTHER,  C_OTHER,  C_BLANK,  C_OTHER,  C_OTHER,  /*   8- 15 */
+    C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  /*  16- 23 */
+    C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  /*  24- 31 */
+    C_BLANK,  C_BANG,   C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_AMP,    C_OTHER,  /*  32- 39 */
+    C_LPAR,   C_RPAR,   C_STAR,   C_PLUS,   C_COMMA,  C_MINUS,  C_DOT,    C_SLASH,  /*  40- 47 */
+    C_DIGIT,  C_DIGIT,  C_DIGIT,  C_DIGIT,  C_DIGIT,  C_DIGIT,  C_DIGIT,  C_DIGIT,  /*  48- 55 */
+    C_DIGIT,  C_DIGIT,  C_COLON,  C_SEMI,   C_LT,     C_EQ,     C_GT,     C_OTHER,  /*  56- 63 */
+    C_OTHER,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /*  64- 71 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /*  72- 79 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /*  80- 87 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  C_OTHER,  /*  88- 95 */
+    C_OTHER,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /*  96-103 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /* 104-111 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  C_ALPHA,  /* 112-119 */
+    C_ALPHA,  C_ALPHA,  C_ALPHA,  C_LBRC,   C_BAR,    C_RBRC,   C_OTHER,  C_OTHER,  /* 120-127 */
+    /* 128-255: bytes fora do ASCII sao C_OTHER */
+};
+
+/* Acoes da tabela de transicao. Valores menores que NSTATES sao o proximo
+   estado (o caractere corrente eh consumido). Valores com ACCEPT terminam o
+   token, cujo tipo fica nos bits de TOKMASK; com CONSUME o caractere
+   corrente tambem faz parte do token. As demais acoes sao tratadas fora do
+   laco principal. */
+#define ACCEPT   0x80
+#define CONSUME  0x40
+#define TOKMASK  0x3f
+#define A(t)     (ACCEPT | (t))
+#define AC(t)    (ACCEPT | CONSUME | (t))
+#define SKIP     (NSTATES)     /* brancos e quebras de linha entre tokens */
+#define COMMENT  (NSTATES + 1) /* inicio de comentario */
+
+/* Monta uma linha da tabela a partir da acao x, que vale para todas as
+   classes exceto as que podem continuar um token (digito, letra, ponto,
+   '=', '*', '&' e '|'). Para essas a acao vem explicita, ou SAME para
+   manter x. A linha de S_START eh escrita por extenso. */
+#define SAME     0xff
+#define PICK(v, x) ((v) == SAME ? (x) : (v))
+#define ROW(x, digit, alpha, dot, eq, star, amp, bar)                       \
+    x, x, x, PICK(digit, x), PICK(alpha, x), PICK(dot, x), x, PICK(eq, x),  \
+    x, x, x, x, PICK(star, x), PICK(amp, x), PICK(bar, x),                  \
+    x, x, x, x, x, x, x, x, x
+
+/* Tabela de transicao indexada por (estado, classe) */
+static const unsigned char delta[NSTATES][NCLASSES] = {
+    [S_START]   = { AC(ERROR), SKIP, SKIP,             /* outro, branco, \n */
+                    S_NUM, S_ID, S_REAL,               /* digito, letra, . */
+                    S_COLON, S_EQ, S_LT, S_GT, S_BANG, /* : = < > ! */
+                    S_SLASH, AC(VEZES), S_AMP, S_BAR,  /* / * & | */
+                    AC(MAIS), AC(MENOS),
+                    AC(ABRE_BLOCO_EXPRESSAO), AC(FECHA_BLOCO_EXPRESSAO),
+                    AC(INICIA_BLOCO_COMANDOS), AC(FECHA_BLOCO_COMANDOS),
+                    AC(SEPARADOR_COMANDO), AC(SEPARADOR_ID),
+                    A(ENDFILE) },
+    /* ROW(acao, digito, letra, ponto, '=', '*', '&', '|') */
+    [S_NUM]     = { ROW(A(NUMERO_INTEIRO), S_NUM, SAME, S_REAL, SAME, SAME, SAME, SAME) },
+    [S_REAL]    = { ROW(A(NUMERO_REAL), S_REAL, SAME, SAME, SAME, SAME, SAME, SAME) },
+    [S_ID]      = { ROW(A(IDENTIFICADOR), S_ID, S_ID, SAME, SAME, SAME, SAME, SAME) },
+    [S_COLON]   = { ROW(A(ERROR), SAME, SAME, SAME, AC(ATRIBUICAO), SAME, SAME, SAME) },
+    [S_EQ]      = { ROW(A(ATRIBUICAO), SAME, SAME, SAME, AC(IGUAL), SAME, SAME, SAME) },
+    [S_LT]      = { ROW(A(MENOR_QUE), SAME, SAME, SAME, AC(MENOR_QUE_IGUAL), SAME, SAME, SAME) },
+    [S_GT]      = { ROW(A(MAIOR_QUE), SAME, SAME, SAME, AC(MAIOR_QUE_IGUAL), SAME, SAME, SAME) },
+    [S_BANG]    = { ROW(A(ERROR), SAME, SAME, SAME, AC(NAO_IGUAL), SAME, SAME, SAME) },
+    [S_SLASH]   = { ROW(A(SOBRE), SAME, SAME, SAME, SAME, COMMENT, SAME, SAME) },
+    /* '&' e '|' isolados iniciam um identificador */
+    [S_AMP]     = { ROW(A(IDENTIFICADOR), S_ID, S_ID, SAME, SAME, SAME, AC(E), SAME) },
+    [S_BAR]     = { ROW(A(IDENTIFICADOR), S_ID, S_ID, SAME, SAME, SAME, SAME, AC(OU)) },
+};
+
+/* Ecoa no listing a linha que comeca em p (EchoSource) */
+static void echoLine(PmCompiler *pm, const char *p) {
+    const char *nl = memchr(p, '\n', pm->end - p);
+    int n = (nl != NULL) ? (int)(nl - p + 1) : (int)(pm->end - p);
+    const char *nul = memchr(p, '\0', n); /* como "%.*s" */
+    char *q;
+    if (nul != NULL)
+        n = (int)(nul - p);
+    if (n > OUT_BUFFER - OUT_INT - 2) {
+        outInt(pm, pm->lineno, 4);
+        outText(pm, ": ", 2);
+        outText(pm, p, n);
+        return;
+    }
+    q = outReserve(pm, n + OUT_INT + 2);
+    q = fmtInt(q, pm->lineno, 4);
+    q = fmtText(q, ": ", 2);
+    outCommit(pm, fmtText(q, p, n));
+}
+
+/* Le todo o conteudo de f para um buffer alocado (usado quando f nao pode ser mapeado) */
+static int readAll(PmCompiler *pm, FILE *f) {
+    size_t cap = 1 << 16, n = 0, r;
+    char *buf = malloc(cap);
+    while (buf != NULL && (r = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += r;
+        if (n == cap) {
+            char *nbuf = realloc(buf, cap *= 2);
+            if (nbuf == NULL) free(buf);
+            buf = nbuf;
+        }
+    }
+    if (buf == NULL) {
+        fprintf(pm->listing, "Out of memory error reading source\n");
+        return FALSE;
+    }
+    pm->sourceText = buf;
+    pm->sourceSize = (long) n;
+    return TRUE;
+}
+
+/* Le o proximo bloco do fluxo para o buffer circular, preservando o
+   texto de [keep, pm->end), que contem o token ainda em andamento.
+   Quando nao cabe mais um bloco ate o fim do buffer, o texto preservado
+   volta para o inicio (so alguns bytes, nunca mais que um token); o
+   buffer so cresce se um unico token for maior que ele. Depois da
+   chamada pm->cur aponta para a nova posicao de keep. Retorna FALSE
+   se o fluxo acabou. read devolve o que o produtor ja escreveu, entao
+   a varredura comeca antes que ele termine. */
+static int streamFill(PmCompiler *pm, const char *keep) {
+    long keepOff = (long) (keep - pm->ring);
+    long keepLen = (long) (pm->end - keep);
+    long n = 0;
+    if (pm->streamEof) {
+        pm->cur = keep;
+        return FALSE;
+    }
+    if (keepOff + keepLen + STREAM_CHUNK > pm->ringSize) {
+        if (keepLen + STREAM_CHUNK > pm->ringSize) {
+            long size = 2 * (keepLen + STREAM_CHUNK);
+            char *ring = realloc(pm->ring, size);
+            if (ring == NULL) {
+                outFlush(pm);
+                fprintf(pm->listing, "Out of memory error at line %d\n", pm->lineno);
+                pm->streamEof = TRUE;
+                pm->cur = keep;
+                return FALSE;
+            }
+            pm->ring = ring;
+            pm->ringSize = size;
+        }
+        memmove(pm->ring, pm->ring + keepOff, keepLen);
+        keepOff = 0;
+    }
+    do
+        n = (long) read(pm->streamFd, pm->ring + keepOff + keepLen, STREAM_CHUNK);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        pm->streamEof = TRUE;
+        n = 0;
+    }
+    pm->cur = pm->ring + keepOff;
+    pm->end = pm->cur + keepLen + n;
+    return n > 0;
+}
+
+/* Prepara a leitura de f em modo de fluxo. O texto dos lexemas eh
+   copiado para pm->pool, que passa a ser pm->sourceText: os tokens
+   continuam sendo fatias de sourceText e o parser nao muda. */
+static int streamOpen(PmCompiler *pm, FILE *f) {
+    pm->streaming = TRUE;
+    pm->streamFd = fileno(f);
+    pm->streamEof = FALSE;
+    pm->ringSize = (long) STREAM_RING * STREAM_CHUNK;
+    pm->ring = malloc(pm->ringSize);
+    pm->poolCapacity = STREAM_CHUNK;
+    pm->pool = malloc(pm->poolCapacity);
+    if (pm->ring == NULL || pm->pool == NULL) {
+        fprintf(pm->listing, "Out of memory error reading source\n");
+        return FALSE;
+    }
+    pm->sourceText = pm->pool;
+    pm->poolSize = 0;
+    pm->cur = pm->end = pm->ring;
+    streamFill(pm, pm->cur);
+    return TRUE;
+}
+
+/* Copia o lexema [s, e) para o fim de pm->pool e retorna o seu
+   deslocamento em pm->sourceText */
+static long poolLexeme(PmCompiler *pm, const char *s, const char *e) {
+    long off = pm->poolSize, len = (long) (e - s);
+    if (off + len > pm->poolCapacity) {
+        long cap = 2 * (off + len);
+        char *pool = realloc(pm->pool, cap);
+        if (pool == NULL) {
+            outFlush(pm);
+            fprintf(pm->listing, "Out of memory error at line %d\n", pm->lineno);
+            return off;
         }
+        pm->pool = pool;
+        pm->poolCapacity = cap;
+        pm->sourceText = pool;
+    }
+    memcpy(pm->pool + off, s, len);
+    pm->poolSize = off + len;
+    return off;
+}
+
+/* Chamada quando a varredura chega ao fim do texto disponivel. Em modo
+   de fluxo le mais um bloco, mantendo o token que comeca em *start, e
+   ajusta os ponteiros; devolve a classe do proximo caractere ou C_EOF
+   se a entrada acabou. */
+static int endClass(PmCompiler *pm, const char **start, const char **p, const char **end) {
+    long pOff;
+    int more;
+    if (!pm->streaming) return C_EOF;
+    pOff = (long) (*p - *start);
+    more = streamFill(pm, *start);
+    *start = pm->cur;
+    *p = *start + pOff;
+    *end = pm->end;
+    return more ? charClass[(unsigned char) **p] : C_EOF;
+}
+
+/* Mapeia o arquivo fonte inteiro na memoria. Pipes e terminais sao
+   lidos em modo de fluxo. */
+int scanOpen(PmCompiler *pm, FILE *f) {
+    struct stat st;
+    int regular;
+    scanClose(pm);
+    regular = fstat(fileno(f), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+#ifndef _WIN32
+    if (regular && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+            pm->sourceText = p;
+            pm->sourceSize = (long) st.st_size;
+            pm->mapped = TRUE;
+        }
+    }
+#endif
+    if (!pm->mapped && !regular) {
+        if (!streamOpen(pm, f))
+            return FALSE;
     } else {
-        return lineBuf[linepos++];
+        if (!pm->mapped && !readAll(pm, f))
+            return FALSE;
+        pm->cur = pm->sourceText;
+        pm->end = pm->sourceText + pm->sourceSize;
+    }
+    pm->lineno = 1;
+    if (EchoSource && pm->cur < pm->end) echoLine(pm, pm->cur);
+    return TRUE;
+}
+
+/* Libera o mapeamento feito por scanOpen (no modo de fluxo, o buffer
+   circular e o pool de lexemas, que eh o proprio sourceText) */
+void scanClose(PmCompiler *pm) {
+    if (pm->sourceText != NULL) {
+#ifndef _WIN32
+        if (pm->mapped) munmap((void *) pm->sourceText, (size_t) pm->sourceSize);
+        else
+#endif
+        free((void *) pm->sourceText);
+    } else
+        free(pm->pool);
+    free(pm->ring);
+    pm->sourceText = pm->cur = pm->end = NULL;
+    pm->sourceSize = 0;
+    pm->mapped = FALSE;
+    pm->streaming = FALSE;
+    pm->ring = pm->pool = NULL;
+    pm->ringSize = pm->poolSize = pm->poolCapacity = 0;
+    pm->tokenOffset = 0;
+    pm->tokenLength = 0;
+}
+
+/* Conta uma quebra de linha que acabou de ser consumida */
+static void newLine(PmCompiler *pm) {
+    pm->lineno++;
+    if (EchoSource && pm->cur < pm->end) echoLine(pm, pm->cur);
+}
+
+/* Contabiliza as n quebras de linha de [from, to) que foram puladas */
+static void countLines(PmCompiler *pm, const char *from, const char *to, int n) {
+    if (!EchoSource) {
+        pm->lineno += n;
+        return;
+    }
+    while ((from = memchr(from, '\n', to - from)) != NULL) {
+        pm->cur = ++from;
+        newLine(pm);
+    }
+}
+
+/* Pula brancos (' ', '\t', '\r') e quebras de linha a partir de p.
+   Retorna o primeiro caractere que nao eh branco e poe em *nl o numero
+   de quebras de linha puladas. */
+static const char *skipBlanks(const char *p, const char *e, int *nl) {
+    int n = 0;
+#ifdef VEC_BYTES
+    const Vec sp = VSPLAT(' '), tab = VSPLAT('\t'), cr = VSPLAT('\r'), lf = VSPLAT('\n');
+    while (e - p >= VEC_BYTES) {
+        Vec v = VLOAD(p);
+        unsigned lfmask = VMASK(VEQ(v, lf));
+        unsigned other = ~VMASK(VOR(VOR(VEQ(v, sp), VEQ(v, tab)), VOR(VEQ(v, cr), VEQ(v, lf)))) & VEC_ALL;
+        if (other != 0) {
+            int i = ctz32(other);
+            *nl = n + popcount32(lfmask & ((1u << i) - 1));
+            return p + i;
+        }
+        n += popcount32(lfmask);
+        p += VEC_BYTES;
+    }
+#endif
+    for (; p < e; p++) {
+        int c = charClass[(unsigned char) *p];
+        if (c == C_NL) n++;
+        else if (c != C_BLANK) break;
     }
+    *nl = n;
+    return p;
 }
 
-/* ungetNextChar retrocede um caractere em lineBuf */
-static void ungetNextChar(void) {
-    if (!EOF_flag) linepos--;
+/* Procura o proximo '*' a partir de p, candidato a fechar um comentario.
+   Retorna e se nao houver nenhum e poe em *nl o numero de quebras de
+   linha puladas. */
+static const char *findStar(const char *p, const char *e, int *nl) {
+    int n = 0;
+#ifdef VEC_BYTES
+    const Vec star = VSPLAT('*'), lf = VSPLAT('\n');
+    while (e - p >= VEC_BYTES) {
+        Vec v = VLOAD(p);
+        unsigned lfmask = VMASK(VEQ(v, lf));
+        unsigned starmask = VMASK(VEQ(v, star));
+        if (starmask != 0) {
+            int i = ctz32(starmask);
+            *nl = n + popcount32(lfmask & ((1u << i) - 1));
+            return p + i;
+        }
+        n += popcount32(lfmask);
+        p += VEC_BYTES;
+    }
+#endif
+    for (; p < e && *p != '*'; p++)
+        n += (*p == '\n');
+    *nl = n;
+    return p;
 }
 
-/* Tabela de busca de palavras reservadas */
-static struct {
-    char* str;
+/* Pula o corpo de um comentario; p aponta logo depois da abertura.
+   Retorna o caractere seguinte ao fechamento ou NULL se o arquivo acabar
+   antes dele. No modo de fluxo o comentario pode atravessar varios
+   blocos; so um '*' no fim do bloco precisa ser mantido, e pm->end
+   pode mudar. */
+static const char *skipComment(PmCompiler *pm, const char *p) {
+    const char *end = pm->end;
+    int nl;
+    for (;;) {
+        const char *q = findStar(p, end, &nl);
+        countLines(pm, p, q, nl);
+        if (q + 1 < end) {
+            if (q[1] == '/') return q + 2;
+            p = q + 1;
+        } else { /* q eh o fim do texto ou o '*' eh o ultimo caractere */
+            if (!pm->streaming || !streamFill(pm, q))
+                return NULL;
+            p = pm->cur;
+            end = pm->end;
+        }
+    }
+}
+
+/* Palavras reservadas, cada uma na posicao dada pelo seu hash */
+static const struct {
+    const char* str;
+    int len;
     TokenType tok;
 } reservedWords[MAXRESERVED] = {
-    {"inteiro", INTEIRO}, {"real", REAL}, {"se", SE}, {"entao", ENTAO},
-    {"senao", SENAO}, {"enquanto", ENQUANTO}, {"repita", REPITA},
-    {"ate", ATE}, {"ler", LER}, {"mostrar", MOSTRAR}
+    {"se", 2, SE}, {"entao", 5, ENTAO}, {"ate", 3, ATE}, {"senao", 5, SENAO},
+    {"enquanto", 8, ENQUANTO}, {"real", 4, REAL}, {"inteiro", 7, INTEIRO},
+    {"repita", 6, REPITA}, {"ler", 3, LER}, {"mostrar", 7, MOSTRAR}
+};
+
+/* Hash perfeito minimo das palavras reservadas:
+     hash(s) = tamanho(s) + firstWeight[s[0]] - HASHBIAS
+   Os pesos foram obtidos por busca exaustiva para que as 10 palavras
+   ocupem exatamente as posicoes 0..MAXRESERVED-1. Letras que nao iniciam
+   nenhuma palavra reservada tem peso 0 e caem fora da tabela. */
+#define HASHBIAS 10
+static const unsigned char firstWeight[256] = {
+    ['a'] = 9, ['e'] = 6, ['i'] = 9, ['l'] = 15, ['m'] = 12, ['r'] = 11, ['s'] = 8
+};
+
+/* Verifica se um identificador é uma palavra reservada: um hash e uma
+   unica comparacao */
+static TokenType reservedLookup(const char *s, int len) {
+    unsigned h = (unsigned) (len + firstWeight[(unsigned char) s[0]] - HASHBIAS);
+    if (h < MAXRESERVED && reservedWords[h].len == len &&
+        memcmp(s, reservedWords[h].str, len) == 0)
+        return reservedWords[h].tok;
+    return IDENTIFICADOR;
+}
+
+/**************************************/
+/* Conversao das constantes numericas */
+/**************************************/
+
+/* Potencias de 10 representaveis exatamente em double */
+static const double exactPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
 };
 
-/* Verifica se um identificador é uma palavra reservada */
-static TokenType reservedLookup(char *s) {
-    int i;
-    for (i = 0; i < MAXRESERVED; i++) {
-        if (!strcmp(s, reservedWords[i].str)) {
-            return reservedWords[i].tok;
+/* Converte o inteiro [s, e) para pm->tokenValue. Retorna FALSE se o
+   valor nao couber em 64 bits. */
+static int convertInteger(PmCompiler *pm, const char *s, const char *e) {
+    unsigned long long v = 0;
+    for (; s < e; s++) {
+        unsigned d = (unsigned) (*s - '0');
+        if (v > (9223372036854775807ULL - d) / 10)
+            return FALSE;
+        v = v * 10 + d;
+    }
+    pm->tokenValue.vint = (long long) v;
+    return TRUE;
+}
+
+/* Converte o real [s, e) (digitos com um '.') para pm->tokenValue com
+   arredondamento correto. Ate 19 digitos significativos formam uma
+   mantissa m inteira e o valor eh m * 10^exp10. Se m <= 2^53 e
+   |exp10| <= 22, m e 10^|exp10| sao exatos em double e uma unica
+   multiplicacao ou divisao IEEE ja arredonda corretamente (Clinger).
+   Os demais casos, raros em programas reais, vao para strtod. */
+static void convertReal(PmCompiler *pm, const char *s, const char *e) {
+    unsigned long long m = 0;
+    int exp10 = 0, digits = 0, dot = FALSE, exact = TRUE;
+    const char *p;
+    for (p = s; p < e; p++) {
+        if (*p == '.') {
+            dot = TRUE;
+        } else if (digits < 19) {
+            m = m * 10 + (unsigned) (*p - '0');
+            if (m != 0) digits++; /* zeros a esquerda nao sao significativos */
+            if (dot) exp10--;
+        } else {
+            if (*p != '0') exact = FALSE;
+            if (!dot) exp10++;
         }
     }
-    return IDENTIFICADOR;
+#if FLT_EVAL_METHOD == 0
+    if (exact && m <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        pm->tokenValue.vreal = (exp10 < 0) ? (double) m / exactPow10[-exp10]
+                                           : (double) m * exactPow10[exp10];
+        return;
+    }
+#endif
+    {
+        char buf[64];
+        char *copy = ((size_t) (e - s) < sizeof(buf)) ? buf : malloc(e - s + 1);
+        if (copy == NULL) {
+            pm->tokenValue.vreal = (double) m;
+            return;
+        }
+        memcpy(copy, s, e - s);
+        copy[e - s] = '\0';
+        pm->tokenValue.vreal = strtod(copy, NULL);
+        if (copy != buf) free(copy);
+    }
 }
 
 /**********************************/
 /* Função principal da varredura  */
 /**********************************/
 
-TokenType getToken(void) {
-    int tokenStringIndex = 0;
+/* O texto eh percorrido diretamente por pm->cur. A cada caractere o laco
+   principal faz apenas uma consulta a charClass e outra a delta; so os
+   brancos e os comentarios saem do laco, para skipBlanks e skipComment. */
+TokenType getToken(PmCompiler *pm) {
+    const char *p, *start, *end;
+    int state = S_START;
+    int act;
     TokenType currentToken;
-    
-    /* estado corrente */
-    StateType state = START;
-    int save;
-
-    while (state != DONE) {
-        int c = getNextChar();
-        save = TRUE;
-
-        switch (state) {
-            case START:
-                if (isdigit(c)) {
-                    state = INNUM;
-                } else if (c == '.') {
-                    state = INREAL;
-                } else if (isalpha(c)) {
-                    state = INID;
-                } else if (c == ':') {
-                    state = INASSIGN;
-                } else if ((c == ' ') || (c == '\t') || (c == '\n')) {
-                    save = FALSE;
-                } else {
-                    state = DONE;
-                    switch (c) {
-                        case EOF:
-                            save = FALSE;
-                            currentToken = ENDFILE;
-                            break;
-                        case '{':
-                            currentToken = INICIA_BLOCO_COMANDOS;
-                            break;
-                        case '}':
-                            currentToken = FECHA_BLOCO_COMANDOS;
-                            break;
-                        case '=':
-                            if (getNextChar() == '=') {
-                                currentToken = IGUAL;
-                            } else {
-                                ungetNextChar();
-                                currentToken = ATRIBUICAO;
-                            }
-                            break;
-                        case '<':
-                            if (getNextChar() == '=') {
-                                currentToken = MENOR_QUE_IGUAL;
-                            } else {
-                                ungetNextChar();
-                                currentToken = MENOR_QUE;
-                            }
-                            break;
-                        case '>':
-                            if (getNextChar() == '=') {
-                                currentToken = MAIOR_QUE_IGUAL;
-                            } else {
-                                ungetNextChar();
-                                currentToken = MAIOR_QUE;
-                            }
-                            break;
-                        case '!':
-                            if (getNextChar() == '=') {
-                                currentToken = NAO_IGUAL;
-                            } else {
-                                ungetNextChar();
-                                currentToken = ERROR;
-                            }
-                            break;
-                        case '+':
-                            currentToken = MAIS;
-                            break;
-                        case '-':
-                            currentToken = MENOS;
-                            break;
-                        case '*':
-                            currentToken = VEZES;
-                            break;
-                        case '/':
-                            if (getNextChar() == '*') {
-                                save = FALSE;
-                                state = INCOMMENT;
-                            } else {
-                                ungetNextChar();
-                                currentToken = SOBRE;
-                            }
-                            break;
-                        case '&':
-                            if(getNextChar() == '&') {
-                                currentToken = E;
-                            } else {
-                                ungetNextChar();
-                                state = INID;
-                            }
-                            break;
-                        case '|':
-                            if(getNextChar() == '|') {
-                                currentToken = OU;
-                            } else {
-                                ungetNextChar();
-                                state = INID;
-                            }
-                            break;
-                        case '(':
-                            currentToken = ABRE_BLOCO_EXPRESSAO;
-                            break;
-                        case ')':
-                            currentToken = FECHA_BLOCO_EXPRESSAO;
-                            break;
-                        case ';':
-                            currentToken = SEPARADOR_COMANDO;
-                            break;
-                        case ',':
-                            currentToken = SEPARADOR_ID;
-                            break;
-                        default:
-                            currentToken = ERROR;
-                            break;
-                    }
-                }
-                break;
-
-            case INCOMMENT:
-                save = FALSE;
-                if (c == EOF)
-                { state = DONE;
-                  currentToken = ENDFILE;
-                }
-                else if (c == '*' && getNextChar() == '/') state = START;
-                break;
-
-            case INASSIGN:
-                state = DONE;
-                if (c == '=') {
-                    currentToken = ATRIBUICAO;
-                } else {
-                    ungetNextChar();
-                    save = FALSE;
-                    currentToken = ERROR;
-                }
-                break;
-
-            case INNUM:
-                if (isdigit(c)) {
-                    // Continua no estado de número
-                } else if (c == '.') {
-                    state = INREAL; // Se encontrar um ponto, muda para INREAL
-                } else {
-                    ungetNextChar();
-                    save = FALSE;
-                    state = DONE;
-                    currentToken = NUMERO_INTEIRO;
-                }
-                break;
 
-            case INREAL:
-                if (isdigit(c)) {
-                    // Continua no estado de número real
-                } else {
-                    ungetNextChar();
-                    save = FALSE;
-                    state = DONE;
-                    currentToken = NUMERO_REAL;
-                }
-                break;
-
-            case INID:
-                if (!isalnum(c)) {
-                    ungetNextChar();
-                    save = FALSE;
-                    state = DONE;
-                    currentToken = IDENTIFICADOR;
-                }
-                break;
+    if (pm->sourceText == NULL &&
+        (pm->source == NULL || !scanOpen(pm, pm->source))) {
+        pm->tokenOffset = pm->tokenLength = 0;
+        return ENDFILE;
+    }
+    p = start = pm->cur;
+    end = pm->end;
 
-            case DONE:
-                tokenString[tokenStringIndex] = '\0';
-                if (currentToken == IDENTIFICADOR) {
-                    currentToken = reservedLookup(tokenString);
-                }
-                break;
-                
-            default:
-                state = DONE;
-                currentToken = ERROR;
+    for (;;) {
+        act = delta[state][(p < end) ? charClass[(unsigned char) *p]
+                                     : endClass(pm, &start, &p, &end)];
+        if (act < NSTATES) {
+            state = act;
+            p++;
+        } else if (act & ACCEPT) {
+            break;
+        } else if (act == SKIP) {
+            /* um branco isolado entre tokens eh o caso comum; so as
+               corridas mais longas vao para skipBlanks */
+            if (*p++ == '\n') {
+                pm->cur = p;
+                newLine(pm);
+            }
+            if (p < end && (charClass[(unsigned char) *p] == C_BLANK ||
+                            charClass[(unsigned char) *p] == C_NL)) {
+                int nl;
+                start = skipBlanks(p, end, &nl);
+                if (nl > 0) countLines(pm, p, start, nl);
+                p = start;
+            }
+            start = p;
+        } else { /* COMMENT: p aponta para o '*' da abertura */
+            p = skipComment(pm, p + 1);
+            end = pm->end;
+            if (p == NULL) {
+                p = end;
+                act = A(ENDFILE);
                 break;
-        }
-
-        if ((save) && (tokenStringIndex <= MAXTOKENLEN)) {
-            tokenString[tokenStringIndex++] = (char)c;
-        }
-        
-        if (state == DONE) {
-            tokenString[tokenStringIndex] = '\0';
-            if (currentToken == IDENTIFICADOR) {
-                currentToken = reservedLookup(tokenString);
             }
+            start = p;
+            state = S_START;
         }
     }
+    if (act & CONSUME) p++;
+    currentToken = (TokenType) (act & TOKMASK);
+    if (currentToken == ENDFILE) start = p;
+    pm->cur = p;
+
+    pm->tokenOffset = pm->streaming ? poolLexeme(pm, start, p)
+                                    : (long) (start - pm->sourceText);
+    pm->tokenLength = (int) (p - start);
+    if (currentToken == IDENTIFICADOR) {
+        currentToken = reservedLookup(start, pm->tokenLength);
+    } else if (currentToken == NUMERO_INTEIRO) {
+        if (!convertInteger(pm, start, p)) currentToken = ERROR;
+    } else if (currentToken == NUMERO_REAL) {
+        convertReal(pm, start, p);
+    }
 
     if (TraceScan) {
-        fprintf(listing, "\t%d: ", lineno);
-        printToken(currentToken, tokenString);
+        /* a linha inteira eh montada de uma vez no buffer, exceto para
+           um lexema do tamanho do buffer */
+        if (pm->tokenLength <= OUT_BUFFER - OUT_INT - OUT_TOKEN) {
+            char *q = outReserve(pm, pm->tokenLength + OUT_INT + OUT_TOKEN);
+            *q++ = '\t';
+            q = fmtInt(q, pm->lineno, 0);
+            q = fmtText(q, ": ", 2);
+            outCommit(pm, fmtToken(q, currentToken, start, pm->tokenLength));
+        } else {
+            outText(pm, "\t", 1);
+            outInt(pm, pm->lineno, 0);
+            outText(pm, ": ", 2);
+            outToken(pm, currentToken, start, pm->tokenLength);
+        }
     }
-    
+    /* o eco e o rastro ficam no buffer da listagem ate o fim do fonte */
+    if (currentToken == ENDFILE)
+        outFlush(pm);
+
     return currentToken;
-}
\ No newline at end of file
+}
+
+/* Aumenta a capacidade dos arrays de tb */
+static int growTokens(PmCompiler *pm, TokenBuffer *tb) {
+    int cap = (tb->capacity > 0) ? tb->capacity * 2 : (int) (pm->sourceSize / 8) + 64;
+    unsigned char *kind = realloc(tb->kind, cap * sizeof(*tb->kind));
+    unsigned int *offset = (kind != NULL) ? realloc(tb->offset, cap * sizeof(*tb->offset)) : NULL;
+    int *length = (offset != NULL) ? realloc(tb->length, cap * sizeof(*tb->length)) : NULL;
+    int *line = (length != NULL) ? realloc(tb->line, cap * sizeof(*tb->line)) : NULL;
+    NumValue *value = (line != NULL) ? realloc(tb->value, cap * sizeof(*tb->value)) : NULL;
+    if (kind != NULL) tb->kind = kind;
+    if (offset != NULL) tb->offset = offset;
+    if (length != NULL) tb->length = length;
+    if (line != NULL) tb->line = line;
+    if (value == NULL) {
+        outFlush(pm);
+        fprintf(pm->listing, "Out of memory error at line %d\n", pm->lineno);
+        return FALSE;
+    }
+    tb->value = value;
+    tb->capacity = cap;
+    return TRUE;
+}
+
+/* Varre o arquivo fonte inteiro, guardando cada token em tb */
+int scanAll(PmCompiler *pm, TokenBuffer *tb) {
+    TokenType t;
+    tb->count = 0;
+    do {
+        int i = tb->count;
+        t = getToken(pm);
+        if (i == tb->capacity && !growTokens(pm, tb))
+            return FALSE;
+        tb->kind[i] = (unsigned char) t;
+        tb->offset[i] = (unsigned int) pm->tokenOffset;
+        tb->length[i] = pm->tokenLength;
+        tb->line[i] = pm->lineno;
+        if (t == NUMERO_INTEIRO || t == NUMERO_REAL)
+            tb->value[i] = pm->tokenValue;
+        tb->count++;
+    } while (t != ENDFILE);
+    return TRUE;
+}
+
+/* Libera os arrays de tb */
+void freeTokens(TokenBuffer *tb) {
+    free(tb->kind);
+    free(tb->offset);
+    free(tb->length);
+    free(tb->line);
+    free(tb->value);
+    tb->kind = NULL;
+    tb->offset = NULL;
+    tb->length = tb->line = NULL;
+    tb->value = NULL;
+    tb->count = tb->capacity = 0;
+}
@@ -1,13 +1,46 @@
 #ifndef _SCAN_H_
 #define _SCAN_H_
 
-/* MAXTOKENLEN é o tamanho máximo de um token */
-#define MAXTOKENLEN 40
+/* Mapeia o arquivo fonte inteiro na memoria. Um pipe ou terminal eh lido
+   em blocos, em modo de fluxo, e a varredura comeca antes de o produtor
+   terminar; nesse caso os lexemas sao copiados para um pool. Um arquivo
+   regular que nao pode ser mapeado eh lido todo para um buffer.
+   O texto fica em pm->sourceText (nao eh terminado por '\0') e o lexema
+   do token corrente eh a fatia de pm->tokenLength caracteres que comeca
+   em pm->tokenOffset. Retorna FALSE em caso de erro. */
+int scanOpen(PmCompiler *pm, FILE *f);
 
-/* tokenString armazena o lexema de cada token */
-extern char tokenString[MAXTOKENLEN+1];
+/* Libera o mapeamento feito por scanOpen */
+void scanClose(PmCompiler *pm);
 
-/* retorna o próximo token do arquivo fonte */
-TokenType getToken(void);
+/* retorna o próximo token do arquivo fonte. Se scanOpen ainda nao foi
+   chamada, mapeia pm->source. Para NUMERO_INTEIRO e NUMERO_REAL o valor
+   ja convertido fica em pm->tokenValue; um inteiro que nao cabe em 64
+   bits eh devolvido como ERROR. O eco (EchoSource) e o rastro
+   (TraceScan) ficam no buffer da listagem (util.h) ate ENDFILE ou
+   outFlush. */
+TokenType getToken(PmCompiler *pm);
+
+/* Fluxo de tokens produzido de uma vez por scanAll, organizado como
+   estrutura de arrays: o token i tem tipo kind[i], lexema de length[i]
+   caracteres em pm->sourceText + offset[i], foi lido na linha line[i] e,
+   se for um numero, tem valor value[i].
+   Os deslocamentos de 32 bits limitam o fonte a 4 GB. */
+typedef struct {
+    unsigned char *kind;
+    unsigned int *offset;
+    int *length;
+    int *line;
+    NumValue *value;
+    int count;
+    int capacity;
+} TokenBuffer;
+
+/* Varre o arquivo fonte inteiro em tb; o ultimo token eh sempre ENDFILE.
+   Retorna FALSE se faltar memoria. */
+int scanAll(PmCompiler *pm, TokenBuffer *tb);
+
+/* Libera os arrays de tb */
+void freeTokens(TokenBuffer *tb);
 
 #endif
@@ -1,9 +1,9 @@
 /****************************************************/
 /* File: symtab.c                                   */
 /* Symbol table implementation for the TINY compiler*/
-/* (allows only one symbol table)                   */
-/* Symbol table is implemented as a chained         */
-/* hash table                                       */
+/* (one symbol table per compilation context)      */
+/* Symbol table is implemented as an open          */
+/* addressing (Robin Hood) hash table               */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
@@ -11,17 +11,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "symtab.h"
 #include "globals.h"
+#include "symtab.h"
+#include "util.h"
+#include "intern.h"
+#include "compiler.h"
 
-/* SIZE -> Tamanho da tabela hash */
-#define SIZE 211
+/* Numero inicial de posicoes da tabela (potencia de 2) */
+#define SYM_SLOTS 256
+
+/* Numero inicial de citacoes de cada variavel */
+#define SYM_LINES 4
 
-/* SHIFT -> Valor usado como multiplicador para o calculo do hash */
+/* SIZE e SHIFT -> Tamanho da antiga tabela encadeada e multiplicador do
+   hash dos nomes, que ainda definem a ordem da listagem */
+#define SIZE 211
 #define SHIFT 4
 
-/* Funcao de hash */
-static int hash (char *key) {
+/* Funcao de hash do nome. Nao eh usada na busca: so define a ordem em
+   que printSymTab lista as variaveis, que eh a mesma de quando a tabela
+   era indexada por este hash. */
+static int nameHash (const char *key) {
   int temp = 0;
   int i = 0;
   while (key[i] != '\0') {
@@ -31,90 +41,331 @@ static int hash (char *key) {
   return temp;
 }
 
-/* Lista encadeada dos numeros de linha do codigo fonte onde a variavel eh referenciada */
-typedef struct LineListRec {
-  int lineno;
-  struct LineListRec *next;
-} *LineList;
-
-/* Registro das informacoes das variaveis a serem
-   armazenadas na tabela de simbolos.
-   Inclui nome, localizacao de memoria e lista de
-   numeros de linha em que a variavel aparece no codigo fonte. */
-typedef struct BucketListRec {
-  char *name;
-  LineList lines;
-  int memloc ; /* Localizacao de memoria da variavel. */
-  struct BucketListRec *next;
-  ExpType type;
-} *BucketList;
-/* Tabela hash */
-static BucketList hashTable[SIZE];
-
-/* Insere numeros de linha e localizacao de memoria na tabela de simbolos.
-   loc = localizacao de memoria. Inserida apenas na primeira chamada.      */
-void st_insert( char * name, int lineno, int loc, ExpType expType ) {
-  int h = hash(name);
-  BucketList l =  hashTable[h];
-  while ((l != NULL) && (strcmp(name,l->name) != 0))
-    l = l->next;
-  if (l == NULL) { /* Variavel ainda nao esta na tabela de simbolos */
-    l = (BucketList) malloc(sizeof(struct BucketListRec));
-    l->name = name;
-    l->type = expType;
-    l->lines = (LineList) malloc(sizeof(struct LineListRec));
-    l->lines->lineno = lineno;
-    l->memloc = loc;
-    l->lines->next = NULL;
-    l->next = hashTable[h];
-    hashTable[h] = l;
+/* Posicao inicial do id. Os ids sao densos, entao o hash de Fibonacci
+   (multiplicar pela razao aurea e ficar com os bits altos) os espalha
+   pela tabela sem nenhuma divisao. */
+static unsigned home (PmCompiler * pm, int id) {
+  return ((unsigned) id * 2654435769u) >> pm->symShift;
+}
+
+/* Distancia entre a posicao i e a posicao inicial do id nela */
+static unsigned probeLength (PmCompiler * pm, unsigned i) {
+  return (i - home(pm,pm->symSlots[i].id)) & pm->symMask;
+}
+
+/* Localiza a posicao da variavel, ou -1. Pela regra Robin Hood as
+   posicoes de cada sondagem estao em ordem de distancia, entao a busca
+   para na primeira mais perto de casa do que o id procurado estaria. */
+static int findSlot(PmCompiler * pm, int id) {
+  unsigned i, d;
+  if (pm->symSlots == NULL)
+    return -1;
+  for (i = home(pm,id), d = 0; pm->symSlots[i].id != -1; i = (i + 1) & pm->symMask, d++) {
+    if (pm->symSlots[i].id == id)
+      return (int) i;
+    if (probeLength(pm,i) < d)
+      break;
   }
-  else { /* Variavel encontrada na tabela de simbolos. Apenas acrescenta numero de linha. */
-    LineList t = l->lines;
-    while (t->next != NULL)
-      t = t->next;
-    t->next = (LineList) malloc(sizeof(struct LineListRec));
-    t->next->lineno = lineno;
-    t->next->next = NULL;
+  return -1;
+}
+
+/* Poe s na posicao i, a distancia d da sua posicao inicial. Quem esta
+   mais perto de casa do que s cede a posicao e continua a sondagem. */
+static void placeSlot(PmCompiler * pm, SymSlot s, unsigned i, unsigned d) {
+  for (; ; i = (i + 1) & pm->symMask, d++) {
+    SymSlot * p = &pm->symSlots[i];
+    unsigned pd;
+    if (p->id == -1) {
+      *p = s;
+      return;
+    }
+    if ((pd = probeLength(pm,i)) < d) {
+      SymSlot evicted = *p;
+      *p = s;
+      s = evicted;
+      d = pd;
+    }
   }
-} /* st_insert */
+}
+
+/* Dobra a quantidade de posicoes, reinserindo as ocupadas */
+static int growSymSlots(PmCompiler * pm) {
+  unsigned n = pm->symSlots ? 2 * (pm->symMask + 1) : SYM_SLOTS;
+  SymSlot * old = pm->symSlots;
+  unsigned oldSize = old ? pm->symMask + 1 : 0, i;
+  SymSlot * slots = (SymSlot *) malloc(n * sizeof(SymSlot));
+  if (slots == NULL)
+    return FALSE;
+  for (i = 0; i < n; i++)
+    slots[i].id = -1;
+  pm->symSlots = slots;
+  pm->symMask = n - 1;
+  for (pm->symShift = 32; n > 1; n >>= 1)
+    pm->symShift--;
+  for (i = 0; i < oldSize; i++)
+    if (old[i].id != -1)
+      placeSlot(pm,old[i],home(pm,old[i].id),0);
+  free(old);
+  return TRUE;
+}
+
+/* Cria o registro de uma variavel, ja com espaco para as primeiras
+   citacoes. Retorna o seu simbolo ou -1 se faltar memoria. */
+static int newSymbol(PmCompiler * pm, int id, int loc) {
+  BucketList l;
+  if (pm->symCount == pm->symCapacity) {
+    int n = pm->symCapacity ? 2 * pm->symCapacity : SYM_SLOTS / 2;
+    BucketList grown = (BucketList) realloc(pm->symbols, n * sizeof(struct BucketListRec));
+    if (grown == NULL)
+      return -1;
+    pm->symbols = grown;
+    pm->symCapacity = n;
+  }
+  l = &pm->symbols[pm->symCount];
+  if ((l->lines = (LineRec *) malloc(SYM_LINES * sizeof(LineRec))) == NULL)
+    return -1;
+  l->id = id;
+  l->memloc = loc;
+  l->type = Void;
+  l->nlines = 0;
+  l->linesCapacity = SYM_LINES;
+  return pm->symCount++;
+}
+
+/* Procura a variavel numa unica sondagem e, se ela nao estiver na
+   tabela, cria o seu registro com a localizacao loc na posicao em que a
+   sondagem parou. Retorna o simbolo ou -1 se faltar memoria. */
+static int findOrCreate(PmCompiler * pm, int id, int loc, int lineno) {
+  unsigned i, d;
+  SymSlot s;
+  if (pm->symSlots == NULL && !growSymSlots(pm)) {
+    fprintf(pm->listing,"Out of memory error at line %d\n",lineno);
+    return -1;
+  }
+  for (i = home(pm,id), d = 0; pm->symSlots[i].id != -1; i = (i + 1) & pm->symMask, d++) {
+    if (pm->symSlots[i].id == id)
+      return pm->symSlots[i].sym;
+    if (probeLength(pm,i) < d)
+      break;
+  }
+  /* Variavel nova: no maximo 3/4 das posicoes ocupadas. Se a tabela
+     crescer, a posicao da insercao eh procurada de novo. */
+  if (4 * (unsigned) (pm->symUsed + 1) > 3 * (pm->symMask + 1)) {
+    if (!growSymSlots(pm)) {
+      fprintf(pm->listing,"Out of memory error at line %d\n",lineno);
+      return -1;
+    }
+    for (i = home(pm,id), d = 0; pm->symSlots[i].id != -1; i = (i + 1) & pm->symMask, d++)
+      if (probeLength(pm,i) < d)
+        break;
+  }
+  if ((s.sym = newSymbol(pm,id,loc)) < 0) {
+    fprintf(pm->listing,"Out of memory error at line %d\n",lineno);
+    return -1;
+  }
+  s.id = id;
+  placeSlot(pm,s,i,d);
+  pm->symUsed++;
+  return s.sym;
+}
+
+/* Garante espaco para mais uma citacao, dobrando o array, de modo que
+   acrescentar uma citacao custa O(1) amortizado */
+static int reserveLine(PmCompiler * pm, BucketList l, int lineno) {
+  int n;
+  LineRec * lines;
+  if (l->nlines < l->linesCapacity)
+    return TRUE;
+  n = 2 * l->linesCapacity;
+  if ((lines = (LineRec *) realloc(l->lines, n * sizeof(LineRec))) == NULL) {
+    fprintf(pm->listing,"Out of memory error at line %d\n",lineno);
+    return FALSE;
+  }
+  l->lines = lines;
+  l->linesCapacity = n;
+  return TRUE;
+}
+
+/* Procura a variavel e, se ela ainda nao estiver na tabela, insere-a
+   com a localizacao de memoria pm->location++. Acrescenta a citacao e
+   retorna o simbolo da variavel. */
+int st_find_or_insert( PmCompiler * pm, int id, int lineno, ExpType expType ) {
+  int count = pm->symCount;
+  int sym = findOrCreate(pm,id,pm->location,lineno);
+  BucketList l;
+  if (sym < 0)
+    return -1;
+  if (pm->symCount > count) /* Variavel nova */
+    pm->location++;
+  l = &pm->symbols[sym];
+  if (!reserveLine(pm,l,lineno))
+    return sym;
+  l->lines[l->nlines].lineno = lineno;
+  l->lines[l->nlines].type = expType;
+  if (l->nlines++ == 0)
+    l->type = expType;
+  return sym;
+} /* st_find_or_insert */
 
 /* Retorna a posicao da varivel na memoria ou -1 se nao encontrada */
-int st_lookup ( char * name ) {
-  int h = hash(name);
-  BucketList l =  hashTable[h];
-  while ((l != NULL) && (strcmp(name,l->name) != 0))
-    l = l->next;
-  if (l == NULL)
+int st_lookup ( PmCompiler * pm, int id ) {
+  int i = findSlot(pm,id);
+  if (i < 0)
     return -1;
   else
-    return l->memloc;
+    return pm->symbols[pm->symSlots[i].sym].memloc;
+}
+
+/* Variavel na ordem de listagem: pelo hash do nome e, dentro do mesmo
+   hash, da mais recente para a mais antiga */
+typedef struct {
+  int hash;
+  int sym;
+} PrintEntry;
+
+static int comparePrintEntry(const void *a, const void *b) {
+  const PrintEntry *x = (const PrintEntry *) a;
+  const PrintEntry *y = (const PrintEntry *) b;
+  if (x->hash != y->hash)
+    return x->hash < y->hash ? -1 : 1;
+  return y->sym - x->sym;
 }
 
 /* Mostra uma listagem formatada do conteudo da tabela de simbolos */
-void printSymTab(FILE * listing) {
-  int i;
-  fprintf(listing,"Variable Name  Location   Type   Line Numbers\n");
-  fprintf(listing,"-------------  --------   ----     ------------\n");
-  for (i=0; i<SIZE; ++i) {
-    if (hashTable[i] != NULL) {
-      BucketList l = hashTable[i];
-      while (l != NULL) {
-        LineList t = l->lines;
-        fprintf(listing,"%-14s ", l->name);
-        fprintf(listing,"%-8d  ", l->memloc);
-        if (l->type == Real) {
-          fprintf(listing, "%-4s", "real");
-        } else if (l->type == Integer) {
-          fprintf(listing, "%-4s", "inteiro");
-        }
-        while (t != NULL) {
-          fprintf(listing,"%4d ", t->lineno);
-          t = t->next;
-        }
-        fprintf(listing,"\n");
-        l = l->next;
-      }
+void printSymTab(PmCompiler * pm, FILE * listing) {
+  PrintEntry *entries;
+  FILE *saved = pm->listing;
+  int i, n = 0;
+  outFlush(pm);
+  pm->listing = listing;
+  outString(pm,"Variable Name  Location   Type   Line Numbers\n");
+  outString(pm,"-------------  --------   ----     ------------\n");
+  entries = (PrintEntry *) malloc(pm->symCount * sizeof(PrintEntry));
+  if (entries == NULL && pm->symCount > 0)
+    outString(pm,"Out of memory error printing symbol table\n");
+  for (i=0; entries != NULL && i<pm->symCount; ++i) {
+    if (pm->symbols[i].nlines == 0) /* removida */
+      continue;
+    entries[n].hash = nameHash(internString(pm,pm->symbols[i].id));
+    entries[n].sym = i;
+    n++;
+  }
+  if (n > 0)
+    qsort(entries, n, sizeof(PrintEntry), comparePrintEntry);
+  for (i=0; i<n; ++i) {
+    BucketList l = &pm->symbols[entries[i].sym];
+    const char *name = internString(pm,l->id);
+    char *p;
+    int j;
+    outField(pm,name,(int) strlen(name),-14);
+    p = outReserve(pm,1 + OUT_INT + 2 + 7);
+    *p++ = ' ';
+    p = fmtInt(p,l->memloc,-8);
+    p = fmtText(p,"  ",2);
+    if (l->type == Real) {
+      p = fmtText(p,"real",4);
+    } else if (l->type == Integer) {
+      p = fmtText(p,"inteiro",7);
+    }
+    outCommit(pm,p);
+    for (j = 0; j < l->nlines; j++) {
+      p = outReserve(pm,OUT_INT + 1);
+      p = fmtInt(p,l->lines[j].lineno,4);
+      *p++ = ' ';
+      outCommit(pm,p);
     }
+    outText(pm,"\n",1);
   }
+  free(entries);
+  outFlush(pm);
+  pm->listing = saved;
 } /* printSymTab */
+
+/* Insere o numero de linha depois dos que sao menores ou iguais a ele */
+int st_insert_sorted( PmCompiler * pm, int id, int lineno, ExpType expType ) {
+  int count = pm->symCount;
+  int sym = findOrCreate(pm,id,pm->location,lineno);
+  int lo = 0, hi;
+  BucketList l;
+  if (sym < 0)
+    return -1;
+  if (pm->symCount > count)
+    pm->location++;
+  l = &pm->symbols[sym];
+  if (!reserveLine(pm,l,lineno))
+    return sym;
+  /* busca binaria da primeira citacao com linha maior */
+  for (hi = l->nlines; lo < hi; ) {
+    int mid = (lo + hi) / 2;
+    if (l->lines[mid].lineno <= lineno)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  memmove(&l->lines[lo+1], &l->lines[lo], (l->nlines - lo) * sizeof(LineRec));
+  l->lines[lo].lineno = lineno;
+  l->lines[lo].type = expType;
+  l->nlines++;
+  l->type = l->lines[0].type;
+  return sym;
+}
+
+/* Remove as citacoes da variavel nas linhas de first a last */
+void st_remove_lines( PmCompiler * pm, int id, int first, int last ) {
+  int s = findSlot(pm,id), i, n = 0;
+  BucketList l;
+  if (s < 0)
+    return;
+  l = &pm->symbols[pm->symSlots[s].sym];
+  for (i = 0; i < l->nlines; i++)
+    if (l->lines[i].lineno < first || l->lines[i].lineno > last)
+      l->lines[n++] = l->lines[i];
+  l->nlines = n;
+  if (n > 0) {
+    l->type = l->lines[0].type;
+    return;
+  }
+  /* O registro fica em symbols, sem citacoes, para que os simbolos das
+     outras variaveis nao mudem; as posicoes seguintes da sondagem
+     voltam uma posicao */
+  for (i = (s + 1) & pm->symMask;
+       pm->symSlots[i].id != -1 && probeLength(pm,i) > 0;
+       s = i, i = (i + 1) & pm->symMask)
+    pm->symSlots[s] = pm->symSlots[i];
+  pm->symSlots[s].id = -1;
+  pm->symUsed--;
+}
+
+/* Soma delta aos numeros de linha maiores ou iguais a fromLine */
+void st_shift_lines( PmCompiler * pm, int fromLine, int delta ) {
+  int i, j;
+  for (i=0; i<pm->symCount; ++i) {
+    BucketList l = &pm->symbols[i];
+    for (j = 0; j < l->nlines; j++)
+      if (l->lines[j].lineno >= fromLine)
+        l->lines[j].lineno += delta;
+  }
+}
+
+/* Esvazia a tabela de simbolos, liberando as citacoes */
+void st_clear(PmCompiler * pm) {
+  int i;
+  for (i=0; i<pm->symCount; ++i)
+    free(pm->symbols[i].lines);
+  if (pm->symUsed > 0)
+    for (i=0; i<=(int)pm->symMask; ++i)
+      pm->symSlots[i].id = -1;
+  pm->symUsed = 0;
+  pm->symCount = 0;
+} /* st_clear */
+
+/* Libera a memoria da tabela */
+void st_free(PmCompiler * pm) {
+  st_clear(pm);
+  free(pm->symSlots);
+  free(pm->symbols);
+  pm->symSlots = NULL;
+  pm->symbols = NULL;
+  pm->symMask = 0;
+  pm->symCapacity = 0;
+}
@@ -1,7 +1,7 @@
 /****************************************************/
 /* File: symtab.h                                   */
 /* Symbol table interface for the TINY compiler     */
-/* (allows only one symbol table)                   */
+/* (one symbol table per compilation context)      */
 /* Compiler Construction: Principles and Practice   */
 /* Kenneth C. Louden                                */
 /****************************************************/
@@ -9,14 +9,65 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
-/* Insere numeros de linha e localizacao de memoria na tabela de simbolos.
-   loc = localizacao de memoria. Inserida apenas na primeira chamada.      */
-void st_insert(char * name, int lineno, int loc, ExpType expType );
+/* Citacao de uma variavel: numero de linha do codigo fonte onde ela eh referenciada */
+typedef struct {
+  int lineno;
+  ExpType type; /* tipo do no na citacao */
+} LineRec;
+
+/* Registro de uma variavel na tabela de simbolos. O simbolo da variavel
+   eh o indice do seu registro em pm->symbols, que nao muda enquanto a
+   tabela nao for esvaziada; os nos da arvore o guardam (TreeNode.sym),
+   entao as passadas seguintes chegam ao tipo e a localizacao de memoria
+   por pm->symbols[t->sym], sem consultar a tabela hash. */
+typedef struct BucketListRec {
+  int id; /* nome, como id da tabela de nomes */
+  int memloc; /* Localizacao de memoria da variavel. */
+  ExpType type; /* tipo da primeira citacao */
+  int nlines, linesCapacity; /* nlines = 0: variavel removida */
+  LineRec *lines; /* citacoes */
+} *BucketList;
+
+/* Posicao da tabela hash */
+typedef struct {
+  int id; /* -1 = posicao vazia */
+  int sym;
+} SymSlot;
+
+/* Procura a variavel numa unica sondagem da tabela hash e, se ela ainda
+   nao estiver na tabela, insere-a com a localizacao de memoria
+   pm->location++. Acrescenta a citacao na linha lineno, com o tipo do
+   no, e retorna o simbolo da variavel, ou -1 se faltar memoria.
+   O nome eh dado pelo seu id na tabela de nomes (intern.h). */
+int st_find_or_insert( PmCompiler * pm, int id, int lineno, ExpType expType );
 
 /* Retorna a posicao da varivel na memoria ou -1 se nao encontrada */
-int st_lookup ( char * name );
+int st_lookup ( PmCompiler * pm, int id );
 
 /* Mostra uma listagem formatada do conteudo da tabela de simbolos */
-void printSymTab(FILE * listing);
+void printSymTab(PmCompiler * pm, FILE * listing);
+
+/* Operacoes para a reanalise incremental (incr.h), que mantem as
+   citacoes de cada variavel em ordem de linha */
+
+/* Como st_find_or_insert, mas a linha entra depois das que sao menores
+   ou iguais a ela, em vez de no fim */
+int st_insert_sorted( PmCompiler * pm, int id, int lineno, ExpType expType );
+
+/* Remove as citacoes da variavel nas linhas de first a last. A variavel
+   sai da tabela se nao sobrar nenhuma; a sua localizacao de memoria nao
+   eh reaproveitada. */
+void st_remove_lines( PmCompiler * pm, int id, int first, int last );
+
+/* Soma delta aos numeros de linha maiores ou iguais a fromLine, em todas
+   as variaveis */
+void st_shift_lines( PmCompiler * pm, int fromLine, int delta );
+
+/* Esvazia a tabela de simbolos, mantendo a memoria das posicoes para a
+   proxima compilacao */
+void st_clear(PmCompiler * pm);
+
+/* Libera a memoria da tabela */
+void st_free(PmCompiler * pm);
 
 #endif
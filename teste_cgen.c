@@ -0,0 +1,195 @@
+/****************************************************/
+/* File: teste_cgen.c                               */
+/* Teste do gerador de codigo e do interpretador    */
+/* do compilador P-                                 */
+/* Uso: teste_cgen                                  */
+/****************************************************/
+
+/* Compila cada programa da tabela com parse, analyze e codeGen e o
+   executa com os dois despachos de runCode, tanto o modulo da memoria
+   quanto o gravado por codeGen e lido de volta por loadCode, conferindo
+   a saida de mostrar com a esperada. Os programas cobrem constantes
+   reais e inteiras em atribuicoes (inclusive a variavel do outro
+   tipo), em mostrar, em testes e na aritmetica mista. Mostra cada
+   programa com saida diferente; o status de saida eh 1 nesse caso. */
+
+#include "util.c"
+#include "intern.c"
+#include "pass.c"
+#include "scan.c"
+#include "parse.c"
+#include "symtab.c"
+#include "analyze.c"
+#include "compiler.c"
+#include "cgen.c"
+#include "vm.c"
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+
+/* Programa, entrada de ler e saida esperada de mostrar */
+typedef struct {
+    const char *name;
+    const char *source;
+    const char *input;
+    const char *output;
+} Program;
+
+static const Program programs[] = {
+    {"real atribuido",
+     "real x;\n"
+     "x = 7.5;\n"
+     "mostrar(x)\n",
+     "", "7.5\n"},
+    {"real em mostrar",
+     "mostrar(2.25);\n"
+     "mostrar(0.1);\n"
+     "mostrar(1234567.5)\n",
+     "", "2.25\n0.1\n1.23457e+06\n"},
+    {"atribuicao entre tipos",
+     "inteiro i;\n"
+     "real r;\n"
+     "i = 2.75;\n"
+     "mostrar(i);\n"
+     "r = 7;\n"
+     "mostrar(r);\n"
+     "r = 100000;\n"
+     "mostrar(r);\n"
+     "i = 123456789012;\n"
+     "mostrar(i)\n",
+     "", "2\n7\n100000\n123456789012\n"},
+    {"aritmetica mista",
+     "inteiro i;\n"
+     "real r;\n"
+     "i = 3;\n"
+     "r = i * 1.5 + 0.25;\n"
+     "mostrar(r);\n"
+     "mostrar(r - 1);\n"
+     "mostrar(7 / 2);\n"
+     "mostrar(7 / 2.0);\n"
+     "mostrar(i + 0.5 * 2);\n"
+     "i = r * 2;\n"
+     "mostrar(i)\n",
+     "", "4.75\n3.75\n3\n3.5\n4\n9\n"},
+    {"testes com reais",
+     "real x;\n"
+     "x = 2.5;\n"
+     "se (x > 2.25) entao mostrar(1) senao mostrar(0);\n"
+     "se (x == 2.5) entao mostrar(1) senao mostrar(0);\n"
+     "se (x < 2) entao mostrar(1) senao mostrar(0);\n"
+     "mostrar(x)\n",
+     "", "1\n1\n0\n2.5\n"},
+    {"laco com reais",
+     "real s;\n"
+     "inteiro n;\n"
+     "s = 0.0;\n"
+     "n = 0;\n"
+     "enquanto (s < 2) {\n"
+     "  s = s + 0.5;\n"
+     "  n = n + 1;\n"
+     "};\n"
+     "mostrar(s);\n"
+     "mostrar(n);\n"
+     "repita {\n"
+     "  s = s - 0.75;\n"
+     "} ate s < 0;\n"
+     "mostrar(s)\n",
+     "", "2\n4\n-0.25\n"},
+    {"leitura de reais",
+     "real x;\n"
+     "inteiro i;\n"
+     "ler(x);\n"
+     "ler(i);\n"
+     "mostrar(x * 2.0);\n"
+     "mostrar(i + x)\n",
+     "1.25\n3\n", "2.5\n4.25\n"},
+};
+#define NPROGRAMS ((int) (sizeof(programs) / sizeof(programs[0])))
+
+/* Arquivo temporario com os len bytes de text, no inicio */
+static FILE *tempWith(const char *text, long len) {
+    FILE *f = tmpfile();
+    if (f == NULL || (long) fwrite(text, 1, len, f) != len || fflush(f) != 0) {
+        perror("tmpfile");
+        exit(1);
+    }
+    rewind(f);
+    return f;
+}
+
+/* Executa m com o despacho d e confere a saida. Retorna FALSE se ela
+   nao for a esperada. */
+static int checkRun(const Program *p, const CodeModule *m, VmDispatch d, const char *what) {
+    static const char *dispatchName[2] = {"goto", "switch"};
+    FILE *in = tempWith(p->input, (long) strlen(p->input)), *out = tempWith("", 0);
+    char text[1024];
+    size_t n;
+    int ran = runCode(m, in, out, d, NULL);
+    rewind(out);
+    n = fread(text, 1, sizeof(text) - 1, out);
+    text[n] = '\0';
+    fclose(in);
+    fclose(out);
+    if (!ran || strcmp(text, p->output) != 0) {
+        fprintf(stderr, "%s (%s, %s): saida\n%s\nesperada\n%s\n", p->name, what,
+                dispatchName[d], text, p->output);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Compila e executa o programa p. Retorna FALSE se alguma execucao
+   nao der a saida esperada. */
+static int checkProgram(PmCompiler *pm, const Program *p) {
+    CodeModule loaded;
+    TreeNode *t;
+    int ok = TRUE, d;
+    resetCompiler(pm);
+    pm->source = tempWith(p->source, (long) strlen(p->source));
+    pm->code = tempWith("", 0);
+    if (!scanOpen(pm, pm->source)) exit(1);
+    t = parse(pm);
+    if (!pm->error)
+        analyze(pm, t);
+    if (!pm->error)
+        codeGen(pm, t);
+    fclose(pm->source);
+    if (pm->error) {
+        fprintf(stderr, "%s: erro de compilacao\n", p->name);
+        fclose(pm->code);
+        pm->code = NULL;
+        return FALSE;
+    }
+    memset(&loaded, 0, sizeof(loaded));
+    rewind(pm->code);
+    if (!loadCode(&loaded, pm->code)) {
+        fprintf(stderr, "%s: modulo gravado invalido\n", p->name);
+        ok = FALSE;
+    }
+    fclose(pm->code);
+    pm->code = NULL;
+    for (d = VM_THREADED; d <= VM_SWITCH; d++) {
+        ok = checkRun(p, &pm->module, (VmDispatch) d, "memoria") && ok;
+        if (loaded.code != NULL)
+            ok = checkRun(p, &loaded, (VmDispatch) d, "arquivo") && ok;
+    }
+    freeCode(&loaded);
+    return ok;
+}
+
+int main(void) {
+    PmCompiler *pm;
+    int failed = 0, i;
+
+    if ((pm = newCompiler()) == NULL) return 1;
+    pm->listing = stderr;
+    for (i = 0; i < NPROGRAMS; i++)
+        failed += !checkProgram(pm, &programs[i]);
+    if (failed == 0)
+        printf("%d programas ok\n", NPROGRAMS);
+    freeCompiler(pm);
+    return failed > 0;
+}
@@ -0,0 +1,351 @@
+/****************************************************/
+/* File: teste_incr.c                               */
+/* Teste da reanalise incremental do compilador P-  */
+/* Uso: teste_incr [-e edicoes] [-s semente]        */
+/*                 [arquivos...]                    */
+/****************************************************/
+
+/* Aplica a cada arquivo (sample.pm se nenhum for dado) edicoes
+   aleatorias por incrEdit e, depois de cada uma, compara incrTree e as
+   citacoes da tabela de simbolos com as de uma compilacao do texto
+   editado desde o inicio, com parse e buildSymtab. As edicoes apagam
+   trechos e linhas, copiam pedacos e linhas do proprio texto e inserem
+   tokens soltos, quebras de linha e comentarios. As edicoes com erro
+   sintatico sao desfeitas logo depois, e a cada REOPEN edicoes o texto
+   volta a ser o original. Os programas grandes podem
+   ser gerados com gerapm. Para no primeiro resultado diferente e mostra
+   a edicao; o status de saida eh 1 se alguma comparacao falhar. */
+
+#include "util.c"
+#include "intern.c"
+#include "pass.c"
+#include "scan.c"
+#include "parse.c"
+#include "symtab.c"
+#include "analyze.c"
+#include "compiler.c"
+#include "incr.c"
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+
+/* Edicoes entre duas voltas ao texto original */
+#define REOPEN 200
+
+/* Trechos inseridos pelas edicoes, alem das copias do proprio texto */
+static const char *pieces[] = {
+    " ", "\n", ";", ";\n", ",", "(", ")", "{", "}", "{\n", "}\n", "=", "==",
+    "+", "*", "<=", "&&", "a", "i", "nova", "x1", "7", "2.5", "/* ", " */",
+    "/* comentario\n */", "inteiro ", "real ", "se ", "entao ", "senao ",
+    "enquanto ", "repita ", "ate ", "ler(a)", "mostrar(i)", "a = a + 1",
+    "i = 2 * (i - 1);\n", "se (a > i) entao\n  mostrar(a)",
+    "enquanto (i < a)\n  i = i + 1", "repita {\n  ler(i);\n} ate i == a",
+};
+#define NPIECES ((int) (sizeof(pieces) / sizeof(pieces[0])))
+
+static unsigned long long seed = 1;
+
+/* Inteiro pseudo-aleatorio em [0, n) */
+static long rnd(long n) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (long) ((seed >> 33) % (unsigned long long) n);
+}
+
+/* Variavel da tabela de simbolos, com o nome para ordenar */
+typedef struct {
+    const char *name;
+    BucketList l;
+} NamedSym;
+
+static int compareNamed(const void *a, const void *b) {
+    return strcmp(((const NamedSym *) a)->name, ((const NamedSym *) b)->name);
+}
+
+/* Variaveis presentes na tabela de pm, em ordem de nome. Retorna
+   quantas sao. */
+static int namedSymbols(PmCompiler *pm, NamedSym **syms) {
+    int i, n = 0;
+    *syms = (NamedSym *) malloc((pm->symCount + 1) * sizeof(NamedSym));
+    if (*syms == NULL) {
+        fprintf(stderr, "Out of memory error\n");
+        exit(1);
+    }
+    for (i = 0; i < pm->symCount; i++)
+        if (pm->symbols[i].nlines > 0) {
+            (*syms)[n].name = internString(pm, pm->symbols[i].id);
+            (*syms)[n++].l = &pm->symbols[i];
+        }
+    qsort(*syms, n, sizeof(NamedSym), compareNamed);
+    return n;
+}
+
+static int sameName(PmCompiler *pa, int a, PmCompiler *pb, int b) {
+    return strcmp(internString(pa, a), internString(pb, b)) == 0;
+}
+
+/* Compara as arvores s (de pa) e t (de pb), com os irmaos. Os nomes sao
+   comparados pelo texto, ja que as duas tabelas de nomes dao ids
+   diferentes. */
+static int sameTree(PmCompiler *pa, TreeNode *s, PmCompiler *pb, TreeNode *t) {
+    int i;
+    for (; s != NULL && t != NULL; s = s->sibling, t = t->sibling) {
+        if (s->nodekind != t->nodekind || s->lineno != t->lineno || s->type != t->type)
+            return FALSE;
+        if (s->nodekind == StmtK) {
+            if (s->kind.stmt != t->kind.stmt)
+                return FALSE;
+            if ((s->kind.stmt == AssignK || s->kind.stmt == ReadK) &&
+                !sameName(pa, s->attr.id, pb, t->attr.id))
+                return FALSE;
+        } else {
+            if (s->kind.exp != t->kind.exp)
+                return FALSE;
+            if (s->kind.exp == OpK && s->attr.op != t->attr.op)
+                return FALSE;
+            if (s->kind.exp == ConstK && memcmp(&s->attr.val, &t->attr.val, sizeof(NumValue)) != 0)
+                return FALSE;
+            if (s->kind.exp == IdK && !sameName(pa, s->attr.id, pb, t->attr.id))
+                return FALSE;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (!sameTree(pa, s->child[i], pb, t->child[i]))
+                return FALSE;
+    }
+    return s == t;
+}
+
+/* Compara as citacoes de cada variavel nas duas tabelas (as
+   localizacoes de memoria podem diferir) */
+static int sameSymbols(PmCompiler *pa, PmCompiler *pb) {
+    NamedSym *a, *b;
+    int na = namedSymbols(pa, &a), nb = namedSymbols(pb, &b), same = TRUE, i = 0, k = 0, j;
+    while (i < na || k < nb) {
+        int c = (i == na) ? 1 : (k == nb) ? -1 : strcmp(a[i].name, b[k].name);
+        if (c != 0) {
+            fprintf(stderr, "  %s so na tabela %s\n", c < 0 ? a[i++].name : b[k++].name,
+                    c < 0 ? "incremental" : "completa");
+            same = FALSE;
+            continue;
+        }
+        for (j = 0; a[i].l->nlines == b[k].l->nlines && j < a[i].l->nlines; j++)
+            if (a[i].l->lines[j].lineno != b[k].l->lines[j].lineno ||
+                a[i].l->lines[j].type != b[k].l->lines[j].type)
+                break;
+        if (j < b[k].l->nlines || a[i].l->nlines != b[k].l->nlines) {
+            fprintf(stderr, "  citacoes de %s diferentes\n", a[i].name);
+            same = FALSE;
+        }
+        i++;
+        k++;
+    }
+    free(a);
+    free(b);
+    return same;
+}
+
+/* Compila do inicio, em pb, os size bytes de text */
+static TreeNode *compileText(PmCompiler *pb, const char *text, long size) {
+    TreeNode *t;
+    FILE *f = tmpfile();
+    resetCompiler(pb);
+    if (f == NULL || (long) fwrite(text, 1, size, f) != size || fflush(f) != 0) {
+        perror("tmpfile");
+        exit(1);
+    }
+    rewind(f);
+    if (!scanOpen(pb, f)) exit(1);
+    t = parse(pb);
+    buildSymtab(pb, t);
+    fclose(f);
+    return t;
+}
+
+/* Edicao: os removed bytes em start trocados pelos added bytes de text */
+typedef struct {
+    long start, removed, added;
+    char *text;
+} Edit;
+
+/* Copia os n bytes de s */
+static char *saveText(const char *s, long n) {
+    char *copy = (char *) malloc(n + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "Out of memory error\n");
+        exit(1);
+    }
+    memcpy(copy, s, n);
+    return copy;
+}
+
+/* Inicio da linha que contem a posicao p de s */
+static long lineStart(const char *s, long p) {
+    while (p > 0 && s[p-1] != '\n')
+        p--;
+    return p;
+}
+
+/* Posicao seguinte ao fim da linha que comeca em p */
+static long lineEnd(const char *s, long size, long p) {
+    const char *nl = memchr(s + p, '\n', size - p);
+    return (nl != NULL) ? (long) (nl - s) + 1 : size;
+}
+
+/* Sorteia uma edicao do texto de pa */
+static void randomEdit(PmCompiler *pa, Edit *ed) {
+    const char *s = pa->sourceText, *piece;
+    long size = pa->sourceSize, from;
+    ed->start = rnd(size + 1);
+    ed->removed = 0;
+    switch (rnd(6)) {
+        case 0: /* apaga um trecho */
+            ed->removed = 1 + rnd(16);
+            ed->added = 0;
+            ed->text = saveText("", 0);
+            break;
+        case 1: /* copia um pedaco do proprio texto */
+            ed->added = 1 + rnd(64);
+            if (ed->added > size) ed->added = size;
+            ed->text = saveText(s + rnd(size - ed->added + 1), ed->added);
+            break;
+        case 2: /* copia uma linha inteira para o inicio de outra */
+            from = lineStart(s, rnd(size + 1));
+            ed->added = lineEnd(s, size, from) - from;
+            ed->text = saveText(s + from, ed->added);
+            ed->start = lineStart(s, ed->start);
+            break;
+        case 3: /* apaga uma linha inteira */
+            ed->start = lineStart(s, ed->start);
+            ed->removed = lineEnd(s, size, ed->start) - ed->start;
+            ed->added = 0;
+            ed->text = saveText("", 0);
+            break;
+        case 4: /* troca um trecho por um token ou comando */
+            ed->removed = rnd(8);
+            /* fall through */
+        default:
+            piece = pieces[rnd(NPIECES)];
+            ed->added = (long) strlen(piece);
+            ed->text = saveText(piece, ed->added);
+            break;
+    }
+    if (ed->start + ed->removed > size)
+        ed->removed = size - ed->start;
+}
+
+/* Aplica a edicao; se incrEdit pedir, o programa eh reaberto */
+static void applyEdit(PmCompiler *pa, Edit *ed, int *reopened) {
+    if (incrEdit(pa, ed->start, ed->removed, ed->text, ed->added) < 0) {
+        if (!incrOpen(pa, pa->sourceText, pa->sourceSize)) exit(1);
+        (*reopened)++;
+    }
+}
+
+/* Compara o estado da reanalise com a compilacao completa do mesmo
+   texto. what e ed descrevem a edicao na mensagem de erro. */
+static int checkEdit(PmCompiler *pa, PmCompiler *pb, const char *fileName,
+                     int e, const char *what, Edit *ed) {
+    TreeNode *t = compileText(pb, pa->sourceText, pa->sourceSize);
+    if (pa->error != pb->error || !sameTree(pa, incrTree(pa), pb, t) || !sameSymbols(pa, pb)) {
+        fprintf(stderr, "%s: %s %d (em %ld, -%ld +%ld \"%.*s\"): resultado diferente "
+                "da compilacao completa\n", fileName, what, e, ed->start, ed->removed,
+                ed->added, (int) (ed->added < 80 ? ed->added : 80), ed->text);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Testa o arquivo com edits edicoes. As que deixam erros sintaticos, e
+   metade das outras, sao desfeitas em seguida, tambem por incrEdit, de
+   modo que cada edicao parte de um texto sem erros. Retorna o numero de
+   falhas. */
+static int testFile(PmCompiler *pa, PmCompiler *pb, const char *fileName, int edits) {
+    FILE *f;
+    char *orig;
+    long size;
+    int e, ok = TRUE, checks = 0, valid = 0, reopened = 0;
+
+    if ((f = fopen(fileName, "rb")) == NULL) {
+        perror(fileName);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    if ((orig = (char *) malloc(size + 1)) == NULL || (long) fread(orig, 1, size, f) != size) {
+        fprintf(stderr, "%s: erro de leitura\n", fileName);
+        fclose(f);
+        free(orig);
+        return 1;
+    }
+    fclose(f);
+
+    for (e = 0; ok && e < edits; e++) {
+        Edit ed, undo;
+        if (e % REOPEN == 0 && !incrOpen(pa, orig, size)) exit(1);
+        randomEdit(pa, &ed);
+        undo.start = ed.start;
+        undo.removed = ed.added;
+        undo.added = ed.removed;
+        undo.text = saveText(pa->sourceText + ed.start, ed.removed);
+        applyEdit(pa, &ed, &reopened);
+        ok = checkEdit(pa, pb, fileName, e, "edicao", &ed);
+        checks++;
+        valid += !pb->error;
+        if (ok && (pb->error || rnd(2))) {
+            applyEdit(pa, &undo, &reopened);
+            ok = checkEdit(pa, pb, fileName, e, "desfazendo a edicao", &undo);
+            checks++;
+            valid += !pb->error;
+        }
+        free(ed.text);
+        free(undo.text);
+    }
+    free(orig);
+    if (!ok)
+        return 1;
+    printf("%s: %d edicoes ok, %d comparacoes (%d sem erro sintatico, %d reaberturas)\n",
+           fileName, edits, checks, valid, reopened);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-e edicoes] [-s semente] [arquivos...]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    static char *defaultFiles[] = {"sample.pm"};
+    PmCompiler *pa, *pb;
+    char **files = defaultFiles;
+    int nfiles = 1, edits = 2000, failures = 0, i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+            edits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned long long) atoll(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (i < argc) {
+        files = argv + i;
+        nfiles = argc - i;
+    }
+
+    if ((pa = newCompiler()) == NULL || (pb = newCompiler()) == NULL) return 1;
+    /* os erros sintaticos das duas compilacoes nao interessam aqui */
+    if ((pa->listing = pb->listing = fopen(NULL_FILE, "w")) == NULL) {
+        perror(NULL_FILE);
+        return 1;
+    }
+    for (i = 0; i < nfiles; i++)
+        failures += testFile(pa, pb, files[i], edits);
+
+    fclose(pa->listing);
+    freeCompiler(pa);
+    freeCompiler(pb);
+    return failures > 0;
+}
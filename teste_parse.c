@@ -1,15 +1,11 @@
 #include "util.c"
+#include "intern.c"
+#include "pass.c"
 #include "scan.c"
 #include "parse.c"
 #include "symtab.c"
 #include "analyze.c"
-
-int lineno = 0;
-int Error;
-
-FILE *source;   /* arquivo de código fonte */
-FILE *listing;  /* arquivo texto de saída */
-FILE *code;     /* arquivo de código para a máquina alvo */
+#include "compiler.c"
 
 int EchoSource = FALSE;
 int TraceScan = FALSE;
@@ -18,37 +14,47 @@ int TraceAnalyze = TRUE;
 int TraceCode = FALSE;
 
 /* Função para fazer o parse e listar a árvore de sintaxe */
-void parse_and_list() {
+void parse_and_list(PmCompiler *pm) {
     TreeNode *t;
 
     // Chama a função de parse
-    t = parse();
+    t = parse(pm);
     
     // Verifica se a árvore de sintaxe foi gerada com sucesso
     if (t != NULL) {
         // Imprime a árvore de sintaxe no arquivo de listagem
-        printTree(t);
+        printTree(pm, t);
     } else {
-        fprintf(listing, "Erro durante o parsing.\n");
+        fprintf(pm->listing, "Erro durante o parsing.\n");
     }
 }
 
-void main() {
+int main(void) {
 	TreeNode *t;
+	PmCompiler *pm;
 	
-	if ((source = fopen("sample.pm", "r")) == NULL) {
+	if ((pm = newCompiler()) == NULL)
+		return 1;
+	if ((pm->source = fopen("sample.pm", "r")) == NULL) {
 		perror("Abertura de sample.pm: ");
-		return;
+		return 1;
 	}
-	if ((listing = fopen("listing.txt", "w")) == NULL) {
+	if ((pm->listing = fopen("listing.txt", "w")) == NULL) {
 		perror("Abertura de listing.txt: ");
-		return;
+		return 1;
+	}
+
+	if (!scanOpen(pm, pm->source)) {
+		fprintf(stderr, "Erro ao mapear sample.pm\n");
+		return 1;
 	}
 
-	t = parse();
-	buildSymtab(t);
-	typeCheck(t);
+	t = parse(pm);
+	buildSymtab(pm, t);
+	typeCheck(pm, t);
 	
-	fclose(source);
-	fclose(listing);
+	fclose(pm->source);
+	fclose(pm->listing);
+	freeCompiler(pm);
+	return 0;
 }
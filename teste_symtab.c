@@ -0,0 +1,260 @@
+/****************************************************/
+/* File: teste_symtab.c                             */
+/* Teste da tabela de simbolos do compilador P-     */
+/* Uso: teste_symtab [-n operacoes] [-v variaveis]  */
+/*                   [-s semente]                   */
+/****************************************************/
+
+/* Executa operacoes aleatorias na tabela de simbolos (insercao de
+   citacoes no fim e em ordem de linha, remocao e deslocamento de
+   linhas, busca e esvaziamento) e confere cada resultado, incluindo as
+   citacoes de cada variavel, com um modelo de referencia, um array
+   indexado pelo id da variavel. Os ids vao de 0 a variaveis-1, densos como os da tabela de
+   nomes, e sao poucos o bastante para que a mesma variavel seja
+   inserida, removida e inserida de novo; a tabela cresce varias vezes
+   entre dois esvaziamentos. A cada CHECK_ALL operacoes todas as
+   variaveis sao conferidas. Para no primeiro resultado diferente; o
+   status de saida eh 1 nesse caso. */
+
+#include "util.c"
+#include "intern.c"
+#include "scan.c"
+#include "symtab.c"
+#include "compiler.c"
+
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int TraceAnalyze = FALSE;
+int TraceCode = FALSE;
+
+/* Operacoes entre duas conferencias de todas as variaveis */
+#define CHECK_ALL 10000
+
+/* Maior numero de linha sorteado */
+#define MAXLINE 1000
+
+/* Variavel no modelo de referencia */
+typedef struct {
+    int memloc; /* -1: fora da tabela */
+    int nlines, capacity;
+    LineRec *lines; /* citacoes, na ordem em que a tabela deve guarda-las */
+} RefVar;
+
+static RefVar *ref;
+static int nvars = 5000, location;
+
+static unsigned long long seed = 1;
+
+/* Inteiro pseudo-aleatorio em [0, n) */
+static long rnd(long n) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (long) ((seed >> 33) % (unsigned long long) n);
+}
+
+/* Confere a variavel id na tabela de pm com o modelo */
+static int checkVar(PmCompiler *pm, int id) {
+    RefVar *r = &ref[id];
+    int memloc = st_lookup(pm, id);
+    if (memloc != r->memloc) {
+        fprintf(stderr, "  variavel %d: st_lookup = %d, esperado %d\n", id, memloc, r->memloc);
+        return FALSE;
+    }
+    if (r->memloc >= 0) {
+        BucketList l = &pm->symbols[pm->symSlots[findSlot(pm, id)].sym];
+        int i;
+        if (l->id != id || l->nlines != r->nlines) {
+            fprintf(stderr, "  variavel %d: registro do id %d com %d citacoes, esperado %d\n",
+                    id, l->id, l->nlines, r->nlines);
+            return FALSE;
+        }
+        for (i = 0; i < r->nlines; i++)
+            if (l->lines[i].lineno != r->lines[i].lineno || l->lines[i].type != r->lines[i].type) {
+                fprintf(stderr, "  variavel %d: citacao %d na linha %d com tipo %d, esperado %d e %d\n",
+                        id, i, l->lines[i].lineno, l->lines[i].type,
+                        r->lines[i].lineno, r->lines[i].type);
+                return FALSE;
+            }
+        if (l->type != r->lines[0].type) {
+            fprintf(stderr, "  variavel %d: tipo diferente do da primeira citacao\n", id);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Confere todas as variaveis, as posicoes ocupadas e ids ausentes */
+static int checkAll(PmCompiler *pm) {
+    int id, used = 0;
+    for (id = 0; id < nvars; id++) {
+        if (!checkVar(pm, id))
+            return FALSE;
+        used += ref[id].memloc >= 0;
+    }
+    if (used != pm->symUsed) {
+        fprintf(stderr, "  %d posicoes ocupadas, esperado %d\n", pm->symUsed, used);
+        return FALSE;
+    }
+    for (id = nvars; id < 2 * nvars; id += 7)
+        if (st_lookup(pm, id) != -1) {
+            fprintf(stderr, "  id ausente %d encontrado\n", id);
+            return FALSE;
+        }
+    return TRUE;
+}
+
+/* Poe a citacao na posicao at das citacoes de r */
+static void refInsert(RefVar *r, int at, int lineno, ExpType type) {
+    if (r->nlines == r->capacity) {
+        r->capacity = r->capacity ? 2 * r->capacity : 4;
+        if ((r->lines = (LineRec *) realloc(r->lines, r->capacity * sizeof(LineRec))) == NULL) {
+            fprintf(stderr, "Out of memory error\n");
+            exit(1);
+        }
+    }
+    memmove(&r->lines[at + 1], &r->lines[at], (r->nlines - at) * sizeof(LineRec));
+    r->lines[at].lineno = lineno;
+    r->lines[at].type = type;
+    r->nlines++;
+}
+
+/* Tira de r as citacoes nas linhas de first a last */
+static void refRemove(RefVar *r, int first, int last) {
+    int i, n = 0;
+    for (i = 0; i < r->nlines; i++)
+        if (r->lines[i].lineno < first || r->lines[i].lineno > last)
+            r->lines[n++] = r->lines[i];
+    if ((r->nlines = n) == 0)
+        r->memloc = -1;
+}
+
+/* Executa uma operacao sorteada. Retorna FALSE se o resultado nao for
+   o do modelo. */
+static int randomOp(PmCompiler *pm, const char **opName) {
+    int id = (int) rnd(nvars), op = (int) rnd(1000), sym, i;
+    RefVar *r = &ref[id];
+    if (op < 600) {
+        /* as citacoes ficam em ordem de linha, como nas duas passadas que
+           usam a tabela: st_find_or_insert acrescenta uma linha que nao eh
+           menor que a ultima */
+        int last = r->nlines ? r->lines[r->nlines - 1].lineno : 1, sorted = op >= 400;
+        int line = sorted ? 1 + (int) rnd(MAXLINE) : last + (int) rnd(last < MAXLINE ? MAXLINE - last + 1 : 2);
+        int at = r->nlines;
+        ExpType type = rnd(2) ? Integer : Real;
+        unsigned mask = pm->symMask;
+        if (sorted) {
+            *opName = "st_insert_sorted";
+            sym = st_insert_sorted(pm, id, line, type);
+            for (at = 0; at < r->nlines && r->lines[at].lineno <= line; at++)
+                ;
+        } else {
+            *opName = "st_find_or_insert";
+            sym = st_find_or_insert(pm, id, line, type);
+        }
+        if (sym < 0 || pm->symbols[sym].id != id) {
+            fprintf(stderr, "  variavel %d: simbolo %d errado\n", id, sym);
+            return FALSE;
+        }
+        /* so a insercao de uma variavel nova pode fazer a tabela crescer */
+        if (r->memloc >= 0 && pm->symMask != mask) {
+            fprintf(stderr, "  variavel %d: a tabela cresceu ao encontra-la\n", id);
+            return FALSE;
+        }
+        if (r->memloc < 0)
+            r->memloc = location++;
+        refInsert(r, at, line, type);
+        if (pm->symbols[sym].memloc != r->memloc) {
+            fprintf(stderr, "  variavel %d: localizacao %d, esperado %d\n",
+                    id, pm->symbols[sym].memloc, r->memloc);
+            return FALSE;
+        }
+    } else if (op < 850) {
+        int first = 1 + (int) rnd(MAXLINE), last = first + (int) rnd(MAXLINE / 4);
+        *opName = "st_remove_lines";
+        st_remove_lines(pm, id, first, last);
+        refRemove(r, first, last);
+    } else if (op < 998) {
+        *opName = "st_lookup";
+    } else if (op == 998) {
+        int from = 1 + (int) rnd(MAXLINE), delta = (int) rnd(7) - 3;
+        *opName = "st_shift_lines";
+        /* como na reanalise, as linhas que o deslocamento alcanca saem antes */
+        if (delta < 0)
+            for (id = 0; id < nvars; id++) {
+                st_remove_lines(pm, id, from + delta, from - 1);
+                refRemove(&ref[id], from + delta, from - 1);
+            }
+        st_shift_lines(pm, from, delta);
+        for (id = 0; id < nvars; id++)
+            for (i = 0; i < ref[id].nlines; i++)
+                if (ref[id].lines[i].lineno >= from)
+                    ref[id].lines[i].lineno += delta;
+        return checkAll(pm);
+    } else if (rnd(10) == 0) {
+        *opName = "st_clear";
+        st_clear(pm);
+        for (id = 0; id < nvars; id++) {
+            ref[id].memloc = -1;
+            ref[id].nlines = 0;
+        }
+        return checkAll(pm);
+    } else
+        *opName = "st_lookup";
+    return checkVar(pm, id);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-n operacoes] [-v variaveis] [-s semente]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    PmCompiler *pm;
+    const char *opName = "";
+    long ops = 3000000, i;
+    int id;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            ops = atol(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+            nvars = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (unsigned long long) atoll(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (nvars < 1) usage(argv[0]);
+
+    if ((pm = newCompiler()) == NULL) return 1;
+    if ((pm->listing = fopen(NULL_FILE, "w")) == NULL) {
+        perror(NULL_FILE);
+        return 1;
+    }
+    if ((ref = (RefVar *) malloc(nvars * sizeof(RefVar))) == NULL) return 1;
+    for (id = 0; id < nvars; id++) {
+        ref[id].memloc = -1;
+        ref[id].nlines = ref[id].capacity = 0;
+        ref[id].lines = NULL;
+    }
+    /* a tabela da a localizacao pm->location++ a cada variavel nova */
+    location = pm->location;
+
+    for (i = 0; i < ops; i++)
+        if (!randomOp(pm, &opName) || ((i + 1) % CHECK_ALL == 0 && !checkAll(pm))) {
+            fprintf(stderr, "operacao %ld (%s): tabela diferente do modelo\n", i, opName);
+            return 1;
+        }
+    if (!checkAll(pm)) {
+        fprintf(stderr, "tabela diferente do modelo no final\n");
+        return 1;
+    }
+    printf("%ld operacoes ok, %d variaveis\n", ops, nvars);
+
+    fclose(pm->listing);
+    freeCompiler(pm);
+    for (id = 0; id < nvars; id++)
+        free(ref[id].lines);
+    free(ref);
+    return 0;
+}
@@ -6,249 +6,654 @@
 
 #include "globals.h"
 #include "util.h"
+#include "intern.h"
+#include "ast.h"
+#include "compiler.h"
 
-/* Imprime um token e seu lexema no arquivo listing */
-void printToken(TokenType token, const char* tokenString) {
+/* Entrega a listing o texto acumulado pelas funcoes out* */
+void outFlush(PmCompiler * pm) {
+  if (pm->outLen > 0) {
+    fwrite(pm->outBuf, 1, pm->outLen, pm->listing);
+    pm->outLen = 0;
+  }
+}
+
+/* Garante n bytes livres no buffer (n <= OUT_BUFFER) e retorna onde
+   escrever */
+char * outReserve(PmCompiler * pm, int n) {
+  if (pm->outLen + n > OUT_BUFFER)
+    outFlush(pm);
+  return pm->outBuf + pm->outLen;
+}
+
+/* Acrescenta o que foi escrito desde outReserve, ate end */
+void outCommit(PmCompiler * pm, char * end) {
+  pm->outLen = (int) (end - pm->outBuf);
+}
+
+/* Acrescenta len caracteres de s */
+void outText(PmCompiler * pm, const char * s, int len) {
+  if (len > OUT_BUFFER) {
+    outFlush(pm);
+    fwrite(s, 1, len, pm->listing);
+    return;
+  }
+  outCommit(pm, fmtText(outReserve(pm, len), s, len));
+}
+
+/* Acrescenta n copias do caractere c, como na indentacao */
+void outRepeat(PmCompiler * pm, char c, int n) {
+  while (n > 0) {
+    int k = n < OUT_BUFFER ? n : OUT_BUFFER;
+    char * p = outReserve(pm, k);
+    memset(p, c, k);
+    outCommit(pm, p + k);
+    n -= k;
+  }
+}
+
+/* Acrescenta s como printf com "%<width>s" (fmtField) */
+void outField(PmCompiler * pm, const char * s, int len, int width) {
+  int w = width < 0 ? -width : width;
+  if (len > OUT_BUFFER - w) {
+    if (width > 0 && w > len)
+      outRepeat(pm, ' ', w - len);
+    outText(pm, s, len);
+    if (width < 0 && w > len)
+      outRepeat(pm, ' ', w - len);
+    return;
+  }
+  outCommit(pm, fmtField(outReserve(pm, len > w ? len : w), s, len, width));
+}
+
+/* Acrescenta v em decimal, como printf com "%<width>lld" */
+void outInt(PmCompiler * pm, long long v, int width) {
+  if ((width < 0 ? -width : width) > OUT_BUFFER - OUT_INT) {
+    char digits[OUT_INT];
+    outField(pm, digits, (int) (fmtInt(digits, v, 0) - digits), width);
+    return;
+  }
+  outCommit(pm, fmtInt(outReserve(pm, OUT_INT + (width < 0 ? -width : width)), v, width));
+}
+
+/* Copia len caracteres de s para p; retorna o fim do que foi escrito,
+   como as demais fmt* */
+char * fmtText(char * p, const char * s, int len) {
+  memcpy(p, s, len);
+  return p + len;
+}
+
+/* Escreve s como printf com "%<width>s": width > 0 alinha a direita e
+   width < 0 a esquerda, completando com espacos */
+char * fmtField(char * p, const char * s, int len, int width) {
+  int pad = (width < 0 ? -width : width) - len;
+  if (width > 0)
+    for (; pad > 0; pad--)
+      *p++ = ' ';
+  p = fmtText(p, s, len);
+  for (; pad > 0; pad--)
+    *p++ = ' ';
+  return p;
+}
+
+/* Escreve v em decimal, como printf com "%<width>lld" */
+char * fmtInt(char * p, long long v, int width) {
+  char digits[OUT_INT];
+  char * d = digits + sizeof(digits);
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+  do {
+    *--d = (char) ('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (v < 0)
+    *--d = '-';
+  if (width == 0)
+    return fmtText(p, d, (int) (digits + sizeof(digits) - d));
+  return fmtField(p, d, (int) (digits + sizeof(digits) - d), width);
+}
+
+/* Escreve v como printf com "%f". Quando |v|*10^6 < 10^13 o produto
+   erra por menos de 0.002, entao so a parte fracionaria perto de 0.5
+   pode arredondar diferente de printf; nesse caso, e para os valores
+   maiores, o texto vem de snprintf. */
+char * fmtReal(char * p, double v) {
+  double scaled = (v < 0 ? -v : v) * 1e6;
+  if (scaled < 1e13) {
+    long long units = (long long) scaled;
+    double frac = scaled - (double) units;
+    if (frac < 0.49 || frac > 0.51) {
+      int i;
+      units += frac > 0.5;
+      if (v < 0 || (v == 0 && 1 / v < 0)) /* -0.0 tambem leva o sinal */
+        *p++ = '-';
+      p = fmtInt(p, units / 1000000, 0);
+      *p = '.';
+      for (i = 6; i > 0; i--) {
+        p[i] = (char) ('0' + units % 10);
+        units /= 10;
+      }
+      return p + 7;
+    }
+  }
+  return p + snprintf(p, OUT_REAL, "%f", v);
+}
+
+/* Escreve o token e seu lexema, como printToken; usa no maximo
+   len + OUT_TOKEN bytes */
+char * fmtToken(char * p, TokenType token, const char* tokenString, int len) {
     switch (token) {
-        /* declaracao de tipo */
+        /* declaracao de tipo, estruturas de decisao e de repeticao,
+           rotinas predefinidas, blocos, numeros e identificador: o
+           proprio lexema */
         case INTEIRO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case REAL:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* estrutura de decisao */
         case SE:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case ENTAO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case SENAO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* estrutura de repeticao */
         case ENQUANTO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case REPITA:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case ATE:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* rotinas predefinidas */
         case LER:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case MOSTRAR:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* operadores */
-        case MAIS:
-            fprintf(listing, "+\n", tokenString);
-            break;
-        case MENOS:
-            fprintf(listing, "-\n", tokenString);
-            break;
-        case VEZES:
-            fprintf(listing, "*\n", tokenString);
-            break;
-        case SOBRE:
-            fprintf(listing, "/\n", tokenString);
-            break;
-        case E:
-            fprintf(listing, "&&\n", tokenString);
-            break;
-        case OU:
-            fprintf(listing, "||\n", tokenString);
-            break;
-        case MENOR_QUE:
-            fprintf(listing, "<\n", tokenString);
-            break;
-        case MENOR_QUE_IGUAL:
-            fprintf(listing, "<=\n", tokenString);
-            break;
-        case MAIOR_QUE:
-            fprintf(listing, ">\n", tokenString);
-            break;
-        case MAIOR_QUE_IGUAL:
-            fprintf(listing, ">=\n", tokenString);
-            break;
-        case IGUAL:
-            fprintf(listing, "==\n", tokenString);
-            break;
-        case NAO_IGUAL:
-            fprintf(listing, "!=\n", tokenString);
-            break;
-        case ATRIBUICAO: 
-            fprintf(listing, "=\n", tokenString);
-            break;
-        /* separadores */
-        case SEPARADOR_COMANDO:
-            fprintf(listing, ";\n", tokenString);
-            break;
-        case SEPARADOR_ID:
-            fprintf(listing, ",\n", tokenString);
-            break;
-        /* blocos */
         case ABRE_BLOCO_EXPRESSAO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case FECHA_BLOCO_EXPRESSAO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case INICIA_BLOCO_COMANDOS:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case FECHA_BLOCO_COMANDOS:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* tipos de numero */
         case NUMERO_INTEIRO:
-            fprintf(listing, "%s\n", tokenString);
-            break;
         case NUMERO_REAL:
-            fprintf(listing, "%s\n", tokenString);
-            break;
-        /* identificador */
         case IDENTIFICADOR:
-            fprintf(listing, "%s\n", tokenString);
+            p = fmtText(p, tokenString, len);
+            break;
+        /* operadores */
+        case MAIS: *p++ = '+'; break;
+        case MENOS: *p++ = '-'; break;
+        case VEZES: *p++ = '*'; break;
+        case SOBRE: *p++ = '/'; break;
+        case E: p = fmtText(p, "&&", 2); break;
+        case OU: p = fmtText(p, "||", 2); break;
+        case MENOR_QUE: *p++ = '<'; break;
+        case MENOR_QUE_IGUAL: p = fmtText(p, "<=", 2); break;
+        case MAIOR_QUE: *p++ = '>'; break;
+        case MAIOR_QUE_IGUAL: p = fmtText(p, ">=", 2); break;
+        case IGUAL: p = fmtText(p, "==", 2); break;
+        case NAO_IGUAL: p = fmtText(p, "!=", 2); break;
+        case ATRIBUICAO: *p++ = '='; break;
+        /* separadores */
+        case SEPARADOR_COMANDO: *p++ = ';'; break;
+        case SEPARADOR_ID: *p++ = ','; break;
+        case ENDFILE: p = fmtText(p, "EOF", 3); break;
+        case ERROR:
+            {   /* como "%.*s": so o lexema de ERROR pode ter '\0', os
+                   outros sao aceitos pelo automato da varredura */
+                const char * nul = memchr(tokenString, '\0', len);
+                if (nul != NULL)
+                    len = (int) (nul - tokenString);
+            }
+            p = fmtText(p, "ERROR: ", 7);
+            p = fmtText(p, tokenString, len);
             break;
-        case ENDFILE: fprintf(listing, "EOF\n"); break;
-        case ERROR: fprintf(listing, "ERROR: %s\n", tokenString); break;
-        default: fprintf(listing, "Unknown token: %d\n", token);
+        default:
+            p = fmtText(p, "Unknown token: ", 15);
+            p = fmtInt(p, token, 0);
     }
+    *p++ = '\n';
+    return p;
+}
+
+/* Acrescenta o token e seu lexema, como printToken */
+void outToken(PmCompiler * pm, TokenType token, const char* tokenString, int len) {
+    if (len > OUT_BUFFER - OUT_TOKEN) {
+        /* lexema maior que o buffer, que so os tokens mostrados pelo
+           lexema e ERROR podem ter: ele vai direto para listing */
+        const char * nul = memchr(tokenString, '\0', len);
+        if (nul != NULL)
+            len = (int) (nul - tokenString);
+        if (token == ERROR)
+            outText(pm, "ERROR: ", 7);
+        outText(pm, tokenString, len);
+        outText(pm, "\n", 1);
+        return;
+    }
+    outCommit(pm, fmtToken(outReserve(pm, len + OUT_TOKEN), token, tokenString, len));
+}
+
+/* Imprime um token e seu lexema (com len caracteres) no arquivo listing */
+void printToken(PmCompiler * pm, TokenType token, const char* tokenString, int len) {
+    outToken(pm, token, tokenString, len);
+    outFlush(pm);
+}
+
+/* Bloco da arena; os dados seguem o cabecalho */
+struct ArenaBlock {
+  struct ArenaBlock * next;
+  size_t size;
+};
+
+#define ARENA_BLOCK (256 * 1024) /* tamanho normal de um bloco */
+#define ARENA_ALIGN 8 /* alinhamento de cada alocacao */
+#define ARENA_HEADER ((sizeof(struct ArenaBlock) + 15) & ~(size_t) 15)
+
+/* Passa para o proximo bloco da arena com pelo menos n bytes livres.
+   Os blocos de compilacoes anteriores sao reaproveitados; so eh
+   alocado um bloco novo quando o proximo nao existe ou eh pequeno. */
+static int arenaGrow(PmCompiler * pm, size_t n) {
+  struct ArenaBlock * b = (pm->arenaCur != NULL) ? pm->arenaCur->next : pm->arenaFirst;
+  if (b == NULL || b->size < n) {
+    size_t size = (n > ARENA_BLOCK) ? n : ARENA_BLOCK;
+    struct ArenaBlock * nb = (struct ArenaBlock *) malloc(ARENA_HEADER + size);
+    if (nb == NULL) return FALSE;
+    nb->size = size;
+    nb->next = b;
+    if (pm->arenaCur != NULL) pm->arenaCur->next = nb;
+    else pm->arenaFirst = nb;
+    b = nb;
+  }
+  pm->arenaCur = b;
+  pm->arenaNext = (char *) b + ARENA_HEADER;
+  pm->arenaEnd = pm->arenaNext + b->size;
+  return TRUE;
+}
+
+/* Aloca n bytes na arena da compilacao */
+void * arenaAlloc(PmCompiler * pm, size_t n) {
+  void * p;
+  n = (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  if ((size_t) (pm->arenaEnd - pm->arenaNext) < n && !arenaGrow(pm, n))
+    return NULL;
+  p = pm->arenaNext;
+  pm->arenaNext += n;
+  return p;
+}
+
+/* Descarta tudo o que foi alocado na arena, em O(1): os blocos ficam
+   para a proxima compilacao */
+void arenaReset(PmCompiler * pm) {
+  pm->arenaCur = NULL;
+  pm->arenaNext = pm->arenaEnd = NULL;
+}
+
+/* Devolve os blocos da arena ao sistema */
+void arenaFree(PmCompiler * pm) {
+  struct ArenaBlock * b = pm->arenaFirst;
+  while (b != NULL) {
+    struct ArenaBlock * next = b->next;
+    free(b);
+    b = next;
+  }
+  pm->arenaFirst = NULL;
+  arenaReset(pm);
 }
 
 /* cria um no de declaracao para a construcao da arvore sintatica */
-TreeNode * newStmtNode(StmtKind kind) {
-  TreeNode *t = (TreeNode *) malloc(sizeof(TreeNode));
+TreeNode * newStmtNode(PmCompiler * pm, StmtKind kind) {
+  TreeNode *t = (TreeNode *) arenaAlloc(pm, sizeof(TreeNode));
   int i;
   if (t == NULL)
-    fprintf(listing,"Out of memory error at line %d\n",lineno);
+    fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
   else {
     for (i=0; i<MAXCHILDREN; i++)
       t->child[i] = NULL;
     t->sibling = NULL;
     t->nodekind = StmtK;
     t->kind.stmt = kind;
-    t->lineno = lineno;
+    t->attr.id = -1;
+    t->lineno = pm->lineno;
+    t->type = Void;
+    t->sym = -1;
   }
   return t;
 }
 
 /* cria um no de expressao para a construcao da arvore sintatica */
-TreeNode *newExpNode(ExpKind kind) {
-  TreeNode *t = (TreeNode *) malloc(sizeof(TreeNode));
+TreeNode *newExpNode(PmCompiler * pm, ExpKind kind) {
+  TreeNode *t = (TreeNode *) arenaAlloc(pm, sizeof(TreeNode));
   int i;
   if (t == NULL)
-    fprintf(listing,"Out of memory error at line %d\n",lineno);
+    fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
   else {
     for (i=0; i<MAXCHILDREN; i++)
       t->child[i] = NULL;
     t->sibling = NULL;
     t->nodekind = ExpK;
     t->kind.exp = kind;
-    t->lineno = lineno;
+    t->lineno = pm->lineno;
     t->type = Void;
+    t->sym = -1;
   }
   return t;
 }
 
-/* aloca espaço e faz copia de uma string existente */
-char * copyString(char * s) {
-  int n;
-  char * t;
-  if (s == NULL)
-    return NULL;
-  n = strlen(s)+1;
-  t = malloc(n);
+/* aloca espaço na arena e faz copia de uma fatia do texto fonte */
+char * copyLexeme(PmCompiler * pm, const char * s, int len) {
+  char * t = (char *) arenaAlloc(pm, len+1);
   if (t == NULL)
-    fprintf(listing,"Out of memory error at line %d\n",lineno);
-  else
-    strcpy(t,s);
+    fprintf(pm->listing,"Out of memory error at line %d\n",pm->lineno);
+  else {
+    memcpy(t,s,len);
+    t[len] = '\0';
+  }
   return t;
 }
 
-/* A variavel indentno eh usada por printTree para armazenar a quantidade de espacos a indentar */
-static int indentno = 0;
+/* Nivel da pilha de percurso: o no e o proximo filho a visitar */
+typedef struct {
+  TreeNode * node;
+  int child;
+} WalkFrame;
 
-/* Macros para incrementar e decrementrar a indentacao */
-#define INDENT indentno+=2
-#define UNINDENT indentno-=2
+typedef struct {
+  unsigned int node;
+  int child;
+} AstWalkFrame;
 
-/* printSpaces faz a indentacao imprimindo espacos */
-static void printSpaces(void) {
-  int i;
-  for (i=0;i<indentno;i++)
-    fprintf(listing," ");
+/* Quantidade de niveis guardados na pilha nativa; alem disso a pilha
+   passa para o heap */
+#define WALK_LOCAL 64
+
+/* Dobra a pilha de percurso, copiando-a para o heap na primeira vez */
+static void * growWalkStack(PmCompiler * pm, void * stack, void * local,
+                            int * capacity, size_t frameSize) {
+  void * grown;
+  if (stack == local) {
+    if ((grown = malloc(2 * *capacity * frameSize)) != NULL)
+      memcpy(grown, stack, *capacity * frameSize);
+  } else
+    grown = realloc(stack, 2 * *capacity * frameSize);
+  if (grown == NULL) {
+    fprintf(pm->listing,"Out of memory error walking syntax tree\n");
+    return NULL;
+  }
+  *capacity *= 2;
+  return grown;
+}
+
+/* Chama as visitas de um no, na ordem do array */
+#define VISIT(visitors,count,pm,t) \
+  { int v_; for (v_ = 0; v_ < (count); v_++) (visitors)[v_]((pm),(t)); }
+
+/* Percorre a arvore com uma pilha explicita. Cada nivel da pilha eh um
+   nivel de aninhamento; ao passar para o irmao o nivel eh reaproveitado,
+   entao listas de comandos de qualquer tamanho nao aprofundam a pilha. */
+void walkTreeN( PmCompiler * pm, TreeNode * t, TreeVisitor * preProc, int npre,
+                TreeVisitor * postProc, int npost ) {
+  WalkFrame local[WALK_LOCAL], * stack = local, * grown;
+  int sp = 0, capacity = WALK_LOCAL;
+  if (t == NULL) return;
+  VISIT(preProc,npre,pm,t);
+  stack[sp].node = t;
+  stack[sp++].child = 0;
+  while (sp > 0) {
+    WalkFrame * f = &stack[sp-1];
+    if (f->child < MAXCHILDREN) { /* desce para o proximo filho */
+      TreeNode * c = f->node->child[f->child++];
+      if (c == NULL) continue;
+      if (sp == capacity) {
+        grown = growWalkStack(pm, stack, local, &capacity, sizeof(WalkFrame));
+        if (grown == NULL) break;
+        stack = grown;
+      }
+      VISIT(preProc,npre,pm,c);
+      stack[sp].node = c;
+      stack[sp++].child = 0;
+    } else { /* filhos visitados: passa para o irmao ou sobe */
+      TreeNode * n = f->node;
+      VISIT(postProc,npost,pm,n);
+      if (n->sibling != NULL) {
+        VISIT(preProc,npre,pm,n->sibling);
+        f->node = n->sibling;
+        f->child = 0;
+      } else
+        sp--;
+    }
+  }
+  if (stack != local) free(stack);
+}
+
+/* walkTreeN com no maximo uma visita de cada lado */
+void walkTree( PmCompiler * pm, TreeNode * t, TreeVisitor preProc, TreeVisitor postProc ) {
+  walkTreeN(pm, t, &preProc, preProc != NULL, &postProc, postProc != NULL);
+}
+
+/* Confere o no n de uma arvore mapeada (astMap), que o percurso alcancou
+   quando esperava o no *next. Como os nos sao numerados em pre-ordem, o
+   percurso chega a eles em ordem crescente, sem pular nenhum; um indice
+   fora de ordem eh um ciclo, um no compartilhado ou um indice fora do
+   array. O tipo de no, o tipo de expressao e o atributo tambem tem que
+   estar nas suas faixas, para que as visitas nao saiam dos arrays. */
+static int validAstNode( PmCompiler * pm, AstTree * a, unsigned int n, unsigned int * next ) {
+  unsigned char k;
+  int attr;
+  if (n != *next || n >= (unsigned int) a->count)
+    return FALSE;
+  (*next)++;
+  k = a->kind[n];
+  attr = a->attr[n];
+  if (a->type[n] > Boolean)
+    return FALSE;
+  if (AST_NODEKIND(k) == StmtK)
+    return AST_STMT(k) <= AssignK &&
+           !((AST_STMT(k) == AssignK || AST_STMT(k) == ReadK) &&
+             (attr < 0 || attr >= internCount(pm)));
+  return AST_NODEKIND(k) == ExpK && AST_EXP(k) <= IdK &&
+         !(AST_EXP(k) == OpK && (attr < 0 || attr > ERROR)) &&
+         !(AST_EXP(k) == ConstK && (attr < 0 || attr >= a->nconsts)) &&
+         !(AST_EXP(k) == IdK && (attr < 0 || attr >= internCount(pm)));
+}
+
+/* walkTree para a arvore compacta. Numa arvore mapeada ainda nao
+   conferida cada no eh conferido (validAstNode) antes das visitas. */
+int walkAst( PmCompiler * pm, AstTree * a, unsigned int n, AstVisitor preProc, AstVisitor postProc ) {
+  AstWalkFrame local[WALK_LOCAL], * stack = local, * grown;
+  int sp = 0, capacity = WALK_LOCAL, check = a->mapping != NULL && !a->verified, ok = TRUE;
+  unsigned int next = n;
+  if (n == AST_NULL) return TRUE;
+  if (check && !validAstNode(pm,a,n,&next)) return FALSE;
+  if (preProc != NULL) preProc(pm,a,n);
+  stack[sp].node = n;
+  stack[sp++].child = 0;
+  while (sp > 0) {
+    AstWalkFrame * f = &stack[sp-1];
+    if (f->child < MAXCHILDREN) {
+      unsigned int c = a->links[f->node].child[f->child++];
+      if (c == AST_NULL) continue;
+      if (sp == capacity) {
+        grown = growWalkStack(pm, stack, local, &capacity, sizeof(AstWalkFrame));
+        if (grown == NULL) break;
+        stack = grown;
+      }
+      if (check && !(ok = validAstNode(pm,a,c,&next))) break;
+      if (preProc != NULL) preProc(pm,a,c);
+      stack[sp].node = c;
+      stack[sp++].child = 0;
+    } else {
+      unsigned int m = f->node, s = a->links[m].sibling;
+      if (postProc != NULL) postProc(pm,a,m);
+      if (s != AST_NULL) {
+        if (check && !(ok = validAstNode(pm,a,s,&next))) break;
+        if (preProc != NULL) preProc(pm,a,s);
+        f->node = s;
+        f->child = 0;
+      } else
+        sp--;
+    }
+  }
+  if (stack != local) free(stack);
+  /* um percurso desde a raiz que passou por todos os nos confere a arvore */
+  if (check && ok && sp == 0 && n == a->root && next == (unsigned int) a->count)
+    a->verified = TRUE;
+  return ok;
+}
+
+/* Macros para incrementar e decrementrar a indentacao. pm->indentno
+   armazena a quantidade de espacos a indentar em printTree */
+#define INDENT pm->indentno+=2
+#define UNINDENT pm->indentno-=2
+
+/* Acrescenta a linha de um no: a indentacao, o rotulo e o texto que o
+   segue (nome, constante ou operador), montados de uma vez no buffer */
+static void printLine(PmCompiler * pm, const char * label, int labelLen,
+                      const char * text, int len) {
+  char * p;
+  if (pm->indentno > OUT_BUFFER - 1 - labelLen - len) {
+    outRepeat(pm,' ',pm->indentno);
+    outText(pm,label,labelLen);
+    outText(pm,text,len);
+    outText(pm,"\n",1);
+    return;
+  }
+  p = outReserve(pm,pm->indentno + labelLen + len + 1);
+  memset(p,' ',pm->indentno);
+  p = fmtText(p + pm->indentno,label,labelLen);
+  p = fmtText(p,text,len);
+  *p++ = '\n';
+  outCommit(pm,p);
+}
+
+/* Linha so com o rotulo, ou com o rotulo e um nome */
+#define printLabel(pm,s) printLine(pm,s,sizeof(s)-1,"",0)
+#define printName(pm,s,name) \
+  do { const char * n_ = (name); printLine(pm,s,sizeof(s)-1,n_,(int) strlen(n_)); } while (0)
+
+/* Desfaz a indentacao de printNode depois que os filhos foram impressos */
+static void unindentNode( PmCompiler * pm, TreeNode * tree ) {
+  (void) tree;
+  UNINDENT;
+}
+
+/* Imprime um no, indentado um nivel alem do seu pai */
+static void printNode( PmCompiler * pm, TreeNode * tree ) {
+  char text[OUT_REAL];
+  INDENT;
+  if (tree->nodekind==StmtK) {
+    switch (tree->kind.stmt) {
+      case DeclK:
+        if (tree->type == Integer) {
+            printLabel(pm,"Inteiro: ");
+        } else {
+            printLabel(pm,"Real: ");
+        }
+        break;
+      case IfK:
+        printLabel(pm,"Se: ");
+        break;
+      case WhileK:
+        printLabel(pm,"Enquanto: ");
+        break;
+      case RepeatK:
+        printLabel(pm,"Repita: ");
+        break;
+      case AssignK:
+        printName(pm,"Atribui para: ",internString(pm,tree->attr.id));
+        break;
+      case ReadK:
+        printName(pm,"Leia: ",internString(pm,tree->attr.id));
+        break;
+      case WriteK:
+        printLabel(pm,"Mostrar: ");
+        break;
+      default:
+        printLabel(pm,"Unknown ExpNode kind");
+        break;
+    }
+  }
+  else if (tree->nodekind==ExpK) {
+    switch (tree->kind.exp) {
+      case OpK: /* o texto do operador, sem o "\n" que fmtToken poe */
+        printLine(pm,"Op: ",4,text,(int) (fmtToken(text,tree->attr.op,"",0) - text) - 1);
+        break;
+      case ConstK:
+        if(tree->type == Real)
+          printLine(pm,"Const: ",7,text,(int) (fmtReal(text,tree->attr.val.vreal) - text));
+        else
+          printLine(pm,"Const: ",7,text,(int) (fmtInt(text,tree->attr.val.vint,0) - text));
+        break;
+      case IdK:
+        printName(pm,"Id: ",internString(pm,tree->attr.id));
+        break;
+      default:
+        printLabel(pm,"Unknown ExpNode kind");
+        break;
+    }
+  }
+  else printLabel(pm,"Unknown node kind");
 }
 
 /* A funcao printTree imprime e arvore sintatica para o arquivo 
  * listing usando indentacao para indicar as sub-arvores
  */
-void printTree( TreeNode * tree ) {
-  int i;
+void printTree( PmCompiler * pm, TreeNode * tree ) {
+  walkTree(pm,tree,printNode,unindentNode);
+  outFlush(pm);
+}
+
+static void unindentAstNode( PmCompiler * pm, AstTree * a, unsigned int n ) {
+  (void) a;
+  (void) n;
+  UNINDENT;
+}
+
+/* printNode para a arvore compacta */
+static void printAstNode( PmCompiler * pm, AstTree * a, unsigned int n ) {
+  unsigned char k = a->kind[n];
+  char text[OUT_REAL];
   INDENT;
-  while (tree != NULL) {
-    printSpaces();
-    if (tree->nodekind==StmtK) {
-      switch (tree->kind.stmt) {
-        case DeclK:
-          if (strcmp(tree->attr.name, "inteiro") == 0) {
-              fprintf(listing, "Inteiro: \n");
-          } else {
-              fprintf(listing, "Real: \n");
-          }
-          break;
-        case IfK:
-          fprintf(listing,"Se: \n");
-          break;
-        case WhileK:
-          fprintf(listing, "Enquanto: \n");
-          break;
-        case RepeatK:
-          fprintf(listing,"Repita: \n");
-          break;
-        case AssignK:
-          fprintf(listing,"Atribui para: %s\n",tree->attr.name);
-          break;
-        case ReadK:
-          fprintf(listing,"Leia: %s\n",tree->attr.name);
-          break;
-        case WriteK:
-          fprintf(listing,"Mostrar: \n");
-          break;
-        default:
-          fprintf(listing,"Unknown ExpNode kind\n");
-          break;
-      }
+  if (AST_NODEKIND(k)==StmtK) {
+    switch (AST_STMT(k)) {
+      case DeclK:
+        if (a->type[n] == Integer) {
+            printLabel(pm,"Inteiro: ");
+        } else {
+            printLabel(pm,"Real: ");
+        }
+        break;
+      case IfK:
+        printLabel(pm,"Se: ");
+        break;
+      case WhileK:
+        printLabel(pm,"Enquanto: ");
+        break;
+      case RepeatK:
+        printLabel(pm,"Repita: ");
+        break;
+      case AssignK:
+        printName(pm,"Atribui para: ",internString(pm,a->attr[n]));
+        break;
+      case ReadK:
+        printName(pm,"Leia: ",internString(pm,a->attr[n]));
+        break;
+      case WriteK:
+        printLabel(pm,"Mostrar: ");
+        break;
+      default:
+        printLabel(pm,"Unknown ExpNode kind");
+        break;
     }
-    else if (tree->nodekind==ExpK) {
-      switch (tree->kind.exp) {
-        case OpK:
-          fprintf(listing,"Op: ");
-          printToken(tree->attr.op,"\0");
-          break;
-        case ConstK:
-          if(tree->type == Real)
-            fprintf(listing,"Const: %f\n",tree->attr.val.vreal);
-          else
-            fprintf(listing, "Const: %d\n", tree->attr.val.vint);
-          break;
-        case IdK:
-          fprintf(listing,"Id: %s\n",tree->attr.name);
-          break;
-        default:
-          fprintf(listing,"Unknown ExpNode kind\n");
-          break;
-      }
+  }
+  else if (AST_NODEKIND(k)==ExpK) {
+    switch (AST_EXP(k)) {
+      case OpK: /* o texto do operador, sem o "\n" que fmtToken poe */
+        printLine(pm,"Op: ",4,text,(int) (fmtToken(text,(TokenType) a->attr[n],"",0) - text) - 1);
+        break;
+      case ConstK:
+        if(a->type[n] == Real)
+          printLine(pm,"Const: ",7,text,(int) (fmtReal(text,a->consts[a->attr[n]].vreal) - text));
+        else
+          printLine(pm,"Const: ",7,text,(int) (fmtInt(text,a->consts[a->attr[n]].vint,0) - text));
+        break;
+      case IdK:
+        printName(pm,"Id: ",internString(pm,a->attr[n]));
+        break;
+      default:
+        printLabel(pm,"Unknown ExpNode kind");
+        break;
     }
-    else fprintf(listing,"Unknown node kind\n");
-    for (i=0;i<MAXCHILDREN;i++)
-      printTree(tree->child[i]);
-    tree = tree->sibling;
   }
-  UNINDENT;
+  else printLabel(pm,"Unknown node kind");
+}
+
+/* Imprime a arvore compacta no mesmo formato de printTree */
+int printAst( PmCompiler * pm, AstTree * a ) {
+  int ok = walkAst(pm,a,a->root,printAstNode,unindentAstNode);
+  outFlush(pm);
+  return ok;
 }
@@ -6,19 +6,113 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
-/* Imprime o token e seu lexema */
-void printToken( TokenType, const char* );
+/* Saida da listagem. As funcoes out* acumulam o texto num buffer do
+   contexto, entregue a pm->listing em blocos grandes por outFlush; quem
+   as usa chama outFlush antes de retornar, para que o texto fique na
+   ordem certa em relacao ao que eh escrito direto com fprintf (como as
+   mensagens de erro). Uma linha inteira pode ser montada de uma vez:
+   outReserve da o espaco, as funcoes fmt* escrevem nele e retornam o
+   fim do que escreveram, e outCommit acrescenta o texto. */
+
+/* Tamanho do buffer da listagem */
+#define OUT_BUFFER (64 * 1024)
+
+/* Bytes que bastam para fmtInt com width 0, para fmtReal e para
+   fmtToken alem do lexema */
+#define OUT_INT 24
+#define OUT_REAL 512
+#define OUT_TOKEN 32
+
+/* Entrega a listing o texto acumulado */
+void outFlush(PmCompiler *);
+
+/* Garante n bytes livres no buffer, n <= OUT_BUFFER, e retorna onde
+   escrever */
+char * outReserve(PmCompiler *, int n);
+
+/* Acrescenta o texto escrito a partir de outReserve, que termina em end */
+void outCommit(PmCompiler *, char * end);
+
+/* Acrescenta len caracteres */
+void outText(PmCompiler *, const char *, int);
+
+/* Acrescenta a string, terminada por '\0' */
+#define outString(pm,s) outText(pm, s, (int) strlen(s))
+
+/* Acrescenta n copias do caractere */
+void outRepeat(PmCompiler *, char, int);
+
+/* Acrescenta len caracteres num campo de width colunas, como "%*s":
+   alinhado a direita se width > 0 e a esquerda se width < 0 */
+void outField(PmCompiler *, const char *, int len, int width);
+
+/* Acrescenta o inteiro em decimal num campo de width colunas, como
+   outField */
+void outInt(PmCompiler *, long long, int width);
+
+/* Como outText, outField e outInt, escrevendo em p */
+char * fmtText(char * p, const char *, int);
+char * fmtField(char * p, const char *, int len, int width);
+char * fmtInt(char * p, long long, int width);
+
+/* Escreve o real como printf com "%f" */
+char * fmtReal(char * p, double);
+
+/* Escreve o token e seu lexema como printToken */
+char * fmtToken(char * p, TokenType, const char*, int);
+
+/* Imprime o token e seu lexema (fatia de len caracteres) */
+void printToken( PmCompiler *, TokenType, const char*, int );
+
+/* printToken sem outFlush */
+void outToken( PmCompiler *, TokenType, const char*, int );
+
+/* Aloca n bytes na arena da compilacao. Tudo o que eh alocado nela (os
+   nos da arvore e os lexemas) eh liberado de uma vez por resetCompiler */
+void * arenaAlloc(PmCompiler *, size_t);
+
+/* Descarta o conteudo da arena em O(1), mantendo os blocos para reuso */
+void arenaReset(PmCompiler *);
+
+/* Devolve os blocos da arena ao sistema */
+void arenaFree(PmCompiler *);
 
 /* Cria um no de declaracao para construcao da arvore sintatica */
-TreeNode * newStmtNode(StmtKind);
+TreeNode * newStmtNode(PmCompiler *, StmtKind);
 
 /* Cria um no de expressao para construcao da arvore sintatica */
-TreeNode * newExpNode(ExpKind);
+TreeNode * newExpNode(PmCompiler *, ExpKind);
 
-/* Aloca espaco e faz copia de uma string */
-char * copyString( char * );
+/* Aloca espaco na arena e faz copia de len caracteres de s, terminando
+   com '\0' */
+char * copyLexeme( PmCompiler *, const char *, int );
+
+/* Visita a um no da arvore de ponteiros ou da arvore compacta (ast.h) */
+typedef void (* TreeVisitor) (PmCompiler *, TreeNode *);
+typedef void (* AstVisitor) (PmCompiler *, AstTree *, unsigned int);
+
+/* Percorre a lista de irmaos que comeca em t e todas as subarvores,
+   chamando preProc em pre-ordem e postProc em pos-ordem (qualquer um
+   pode ser NULL). Nao usa recursao: a pilha eh explicita e so cresce com
+   o aninhamento, nunca com o tamanho das listas de comandos. */
+void walkTree( PmCompiler *, TreeNode *, TreeVisitor, TreeVisitor );
+
+/* walkTree com varias visitas em cada no, num unico percurso: as npre
+   visitas de preProc sao chamadas em ordem na pre-ordem e as npost de
+   postProc na pos-ordem */
+void walkTreeN( PmCompiler *, TreeNode *, TreeVisitor *, int, TreeVisitor *, int );
+
+/* walkTree para a arvore compacta, a partir do no dado. Numa arvore
+   mapeada por astMap os nos sao conferidos a medida que o percurso chega
+   a eles, ate que um percurso desde a raiz passe por todos; retorna FALSE
+   (sem visitar o no invalido nem os seguintes) se a arvore for invalida. */
+int walkAst( PmCompiler *, AstTree *, unsigned int, AstVisitor, AstVisitor );
 
 /* Imprime a arvore sintatica usando indentacao para indicar as subarvores  */
-void printTree( TreeNode * );
+void printTree( PmCompiler *, TreeNode * );
+
+/* Imprime a arvore compacta (ast.h) no mesmo formato de printTree.
+   Retorna FALSE se a arvore mapeada for invalida (walkAst). */
+int printAst( PmCompiler *, AstTree * );
 
 #endif
@@ -0,0 +1,446 @@
+/****************************************************/
+/* File: vm.c                                       */
+/* Bytecode interpreter for the P- compiler         */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "vm.h"
+
+#include <limits.h>
+
+/* Tamanho do buffer da saida do programa */
+#define VM_OUT_BUFFER (64 * 1024)
+
+/* Estado de uma execucao */
+typedef struct {
+  const CodeModule * module;
+  NumValue * mem; /* variaveis, indexadas por memloc */
+  NumValue reg[CODE_MAXREGS];
+  FILE * in, * out;
+  int outLen;
+  char outBuf[VM_OUT_BUFFER];
+} VmState;
+
+/*************************************************/
+/*************  Leitura do modulo  ***************/
+/*************************************************/
+
+int loadCode(CodeModule * m, FILE * f) {
+  CodeFileHeader h;
+  long start, end;
+  if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, CODE_MAGIC, sizeof(h.magic)) != 0 ||
+      h.version != CODE_VERSION || h.byteOrder != CODE_BYTE_ORDER ||
+      h.headerSize != sizeof(h) || h.constSize != sizeof(NumValue) ||
+      h.nslots < 0 || h.nregs < 0 || h.nregs > CODE_MAXREGS ||
+      h.ncode < 1 || h.nconsts < 0 || h.nlines < 0)
+    return FALSE;
+  /* os tamanhos do cabecalho devem caber no resto do arquivo, para que
+     um arquivo corrompido nao peca memoria demais */
+  if ((start = ftell(f)) < 0 || fseek(f, 0, SEEK_END) != 0 || (end = ftell(f)) < 0 ||
+      fseek(f, start, SEEK_SET) != 0 ||
+      (double) h.nconsts * sizeof(NumValue) + (double) h.ncode * sizeof(unsigned int) +
+      (double) h.nlines * sizeof(CodeLine) > (double) (end - start))
+    return FALSE;
+  m->nslots = h.nslots;
+  m->nregs = h.nregs;
+  m->code = (unsigned int *) malloc(h.ncode * sizeof(unsigned int));
+  m->consts = (NumValue *) malloc((h.nconsts + 1) * sizeof(NumValue));
+  m->lines = (CodeLine *) malloc((h.nlines + 1) * sizeof(CodeLine));
+  if (m->code == NULL || m->consts == NULL || m->lines == NULL ||
+      fread(m->consts, sizeof(NumValue), h.nconsts, f) != (size_t) h.nconsts ||
+      fread(m->code, sizeof(unsigned int), h.ncode, f) != (size_t) h.ncode ||
+      fread(m->lines, sizeof(CodeLine), h.nlines, f) != (size_t) h.nlines) {
+    freeCode(m);
+    return FALSE;
+  }
+  m->ncode = m->codeCapacity = h.ncode;
+  m->nconsts = m->constsCapacity = h.nconsts;
+  m->nlines = m->linesCapacity = h.nlines;
+  if (!verifyCode(m)) {
+    freeCode(m);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+int verifyCode(const CodeModule * m) {
+  unsigned char * start;
+  int pc, last = -1, ok = TRUE;
+  if (m->ncode < 1 || (start = (unsigned char *) calloc(m->ncode, 1)) == NULL)
+    return FALSE;
+  /* inicio de cada instrucao, e operandos de memoria e constantes */
+  for (pc = 0; ok && pc < m->ncode; pc += CODE_WIDE(CODE_OP(m->code[pc])) ? 2 : 1) {
+    unsigned int word = m->code[pc], w;
+    OpCode op = CODE_OP(word);
+    start[pc] = TRUE;
+    last = pc;
+    if (op >= OP_COUNT || (CODE_WIDE(op) && pc + 1 >= m->ncode)) {
+      ok = FALSE;
+      break;
+    }
+    w = CODE_WIDE(op) ? m->code[pc+1] : 0;
+    if ((op == OP_LOADKI || op == OP_LOADKR) && w >= (unsigned int) m->nconsts)
+      ok = FALSE;
+    if ((op == OP_GET || op == OP_PUT || op == OP_READI || op == OP_READR) &&
+        w >= (unsigned int) m->nslots)
+      ok = FALSE;
+  }
+  /* destinos dos desvios */
+  for (pc = 0; ok && pc < m->ncode; pc += CODE_WIDE(CODE_OP(m->code[pc])) ? 2 : 1) {
+    OpCode op = CODE_OP(m->code[pc]);
+    if ((op == OP_JMP || op == OP_JZ || op == OP_JNZ) &&
+        (m->code[pc+1] >= (unsigned int) m->ncode || !start[m->code[pc+1]]))
+      ok = FALSE;
+  }
+  ok = ok && last >= 0 && (CODE_OP(m->code[last]) == OP_HALT || CODE_OP(m->code[last]) == OP_JMP);
+  free(start);
+  return ok;
+}
+
+void freeCode(CodeModule * m) {
+  free(m->code);
+  free(m->consts);
+  free(m->lines);
+  memset(m, 0, sizeof(*m));
+}
+
+/*************************************************/
+/**********  Entrada, saida e erros  *************/
+/*************************************************/
+
+/* Entrega a out a saida acumulada */
+static void vmFlush(VmState * vm) {
+  if (vm->outLen > 0) {
+    fwrite(vm->outBuf, 1, vm->outLen, vm->out);
+    fflush(vm->out);
+    vm->outLen = 0;
+  }
+}
+
+static void vmWriteInt(VmState * vm, long long v) {
+  char digits[24];
+  char * p = digits + sizeof(digits);
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+  if (vm->outLen > VM_OUT_BUFFER - 32)
+    vmFlush(vm);
+  *--p = '\n';
+  do {
+    *--p = (char) ('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (v < 0)
+    *--p = '-';
+  memcpy(vm->outBuf + vm->outLen, p, digits + sizeof(digits) - p);
+  vm->outLen += (int) (digits + sizeof(digits) - p);
+}
+
+static void vmWriteReal(VmState * vm, double v) {
+  if (vm->outLen > VM_OUT_BUFFER - 64)
+    vmFlush(vm);
+  vm->outLen += snprintf(vm->outBuf + vm->outLen, 64, "%g\n", v);
+}
+
+/* Le um numero para mem[slot]. Retorna FALSE se a entrada acabar ou nao
+   for um numero. */
+static int vmRead(VmState * vm, unsigned int slot, int real) {
+  vmFlush(vm);
+  if (real)
+    return fscanf(vm->in, "%lf", &vm->mem[slot].vreal) == 1;
+  return fscanf(vm->in, "%lld", &vm->mem[slot].vint) == 1;
+}
+
+/* Mostra o erro de execucao na instrucao pc e retorna FALSE */
+static int runtimeError(VmState * vm, int pc, const char * message) {
+  const CodeModule * m = vm->module;
+  int lo = 0, hi = m->nlines - 1, line = 0;
+  vmFlush(vm);
+  while (lo <= hi) { /* ultima linha que comeca antes de pc */
+    int mid = (lo + hi) / 2;
+    if (m->lines[mid].pc <= pc) {
+      line = m->lines[mid].lineno;
+      lo = mid + 1;
+    } else
+      hi = mid - 1;
+  }
+  fprintf(stderr, "Runtime error at line %d: %s\n", line, message);
+  return FALSE;
+}
+
+/* Aritmetica inteira com volta em 64 bits */
+#define WRAP(x,op,y) ((long long) ((unsigned long long) (x) op (unsigned long long) (y)))
+
+/* Real para inteiro, truncado e saturado (NaN da zero) */
+static long long realToInt(double d) {
+  if (d != d)
+    return 0;
+  if (d >= 9223372036854775807.0)
+    return LLONG_MAX;
+  if (d <= -9223372036854775808.0)
+    return LLONG_MIN;
+  return (long long) d;
+}
+
+/*************************************************/
+/***********  Laco com switch  *******************/
+/*************************************************/
+
+/* Operandos da instrucao corrente */
+#define RA vm->reg[CODE_A(word)]
+#define RB vm->reg[CODE_B(word)]
+#define RC vm->reg[CODE_C(word)]
+#define W code[pc+1]
+
+static int runSwitch(VmState * vm, long long * steps) {
+  const unsigned int * code = vm->module->code;
+  const NumValue * consts = vm->module->consts;
+  NumValue * mem = vm->mem;
+  long long count = 0;
+  int pc = 0;
+  for (;;) {
+    unsigned int word = code[pc];
+    count++;
+    switch (CODE_OP(word)) {
+      case OP_HALT:
+        *steps = count;
+        return TRUE;
+      case OP_LOADI: RA.vint = CODE_SBX(word); pc++; break;
+      case OP_ITOR: RA.vreal = (double) RB.vint; pc++; break;
+      case OP_RTOI: RA.vint = realToInt(RB.vreal); pc++; break;
+      case OP_ADDI: RA.vint = WRAP(RB.vint, +, RC.vint); pc++; break;
+      case OP_SUBI: RA.vint = WRAP(RB.vint, -, RC.vint); pc++; break;
+      case OP_MULI: RA.vint = WRAP(RB.vint, *, RC.vint); pc++; break;
+      case OP_DIVI:
+        if (RC.vint == 0) {
+          *steps = count;
+          return runtimeError(vm, pc, "division by zero");
+        }
+        RA.vint = (RC.vint == -1) ? WRAP(0, -, RB.vint) : RB.vint / RC.vint;
+        pc++;
+        break;
+      case OP_ADDR: RA.vreal = RB.vreal + RC.vreal; pc++; break;
+      case OP_SUBR: RA.vreal = RB.vreal - RC.vreal; pc++; break;
+      case OP_MULR: RA.vreal = RB.vreal * RC.vreal; pc++; break;
+      case OP_DIVR: RA.vreal = RB.vreal / RC.vreal; pc++; break;
+      case OP_LTI: RA.vint = RB.vint < RC.vint; pc++; break;
+      case OP_LEI: RA.vint = RB.vint <= RC.vint; pc++; break;
+      case OP_GTI: RA.vint = RB.vint > RC.vint; pc++; break;
+      case OP_GEI: RA.vint = RB.vint >= RC.vint; pc++; break;
+      case OP_EQI: RA.vint = RB.vint == RC.vint; pc++; break;
+      case OP_NEI: RA.vint = RB.vint != RC.vint; pc++; break;
+      case OP_LTR: RA.vint = RB.vreal < RC.vreal; pc++; break;
+      case OP_LER: RA.vint = RB.vreal <= RC.vreal; pc++; break;
+      case OP_GTR: RA.vint = RB.vreal > RC.vreal; pc++; break;
+      case OP_GER: RA.vint = RB.vreal >= RC.vreal; pc++; break;
+      case OP_EQR: RA.vint = RB.vreal == RC.vreal; pc++; break;
+      case OP_NER: RA.vint = RB.vreal != RC.vreal; pc++; break;
+      case OP_TESTR: RA.vint = RB.vreal != 0.0; pc++; break;
+      case OP_AND: RA.vint = RB.vint != 0 && RC.vint != 0; pc++; break;
+      case OP_OR: RA.vint = RB.vint != 0 || RC.vint != 0; pc++; break;
+      case OP_WRITEI: vmWriteInt(vm, RA.vint); pc++; break;
+      case OP_WRITER: vmWriteReal(vm, RA.vreal); pc++; break;
+      case OP_LOADKI:
+      case OP_LOADKR: RA = consts[W]; pc += 2; break;
+      case OP_GET: RA = mem[W]; pc += 2; break;
+      case OP_PUT: mem[W] = RA; pc += 2; break;
+      case OP_JMP: pc = (int) W; break;
+      case OP_JZ: pc = (RA.vint == 0) ? (int) W : pc + 2; break;
+      case OP_JNZ: pc = (RA.vint != 0) ? (int) W : pc + 2; break;
+      case OP_READI:
+      case OP_READR:
+        if (!vmRead(vm, W, CODE_OP(word) == OP_READR)) {
+          *steps = count;
+          return runtimeError(vm, pc, "invalid input");
+        }
+        pc += 2;
+        break;
+      default: /* verifyCode nao deixa chegar aqui */
+        *steps = count;
+        return runtimeError(vm, pc, "invalid instruction");
+    }
+  }
+}
+
+#undef RA
+#undef RB
+#undef RC
+#undef W
+
+/*************************************************/
+/********  Despacho por goto computado  **********/
+/*************************************************/
+
+#ifdef __GNUC__
+
+/* Instrucao traduzida: o endereco do tratador e os operandos ja
+   decodificados. w eh sBx, o indice da constante, a posicao de memoria
+   ou o indice da instrucao de destino. */
+typedef struct {
+  const void * op;
+  unsigned char a, b, c;
+  int w;
+} VmInsn;
+
+#define RA vm->reg[ip->a]
+#define RB vm->reg[ip->b]
+#define RC vm->reg[ip->c]
+#define DISPATCH() do { count++; goto *ip->op; } while (0)
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+
+static int runThreaded(VmState * vm, long long * steps) {
+  static const void * const handler[OP_COUNT] = {
+    [OP_HALT] = &&L_HALT, [OP_LOADI] = &&L_LOADI, [OP_ITOR] = &&L_ITOR, [OP_RTOI] = &&L_RTOI,
+    [OP_ADDI] = &&L_ADDI, [OP_SUBI] = &&L_SUBI, [OP_MULI] = &&L_MULI, [OP_DIVI] = &&L_DIVI,
+    [OP_ADDR] = &&L_ADDR, [OP_SUBR] = &&L_SUBR, [OP_MULR] = &&L_MULR, [OP_DIVR] = &&L_DIVR,
+    [OP_LTI] = &&L_LTI, [OP_LEI] = &&L_LEI, [OP_GTI] = &&L_GTI, [OP_GEI] = &&L_GEI,
+    [OP_EQI] = &&L_EQI, [OP_NEI] = &&L_NEI,
+    [OP_LTR] = &&L_LTR, [OP_LER] = &&L_LER, [OP_GTR] = &&L_GTR, [OP_GER] = &&L_GER,
+    [OP_EQR] = &&L_EQR, [OP_NER] = &&L_NER,
+    [OP_TESTR] = &&L_TESTR, [OP_AND] = &&L_AND, [OP_OR] = &&L_OR,
+    [OP_WRITEI] = &&L_WRITEI, [OP_WRITER] = &&L_WRITER,
+    [OP_LOADKI] = &&L_LOADK, [OP_LOADKR] = &&L_LOADK, [OP_GET] = &&L_GET, [OP_PUT] = &&L_PUT,
+    [OP_JMP] = &&L_JMP, [OP_JZ] = &&L_JZ, [OP_JNZ] = &&L_JNZ,
+    [OP_READI] = &&L_READI, [OP_READR] = &&L_READR
+  };
+  const CodeModule * m = vm->module;
+  const NumValue * consts = m->consts;
+  NumValue * mem = vm->mem;
+  VmInsn * code, * ip;
+  int * index, * pcOf, pc, n, ok = FALSE;
+  long long count = 0;
+
+  /* index[pc] eh a instrucao traduzida que comeca na palavra pc, e
+     pcOf o caminho de volta, para a linha dos erros */
+  code = (VmInsn *) malloc(m->ncode * sizeof(VmInsn));
+  index = (int *) malloc(m->ncode * sizeof(int));
+  pcOf = (int *) malloc(m->ncode * sizeof(int));
+  if (code == NULL || index == NULL || pcOf == NULL) {
+    free(code);
+    free(index);
+    free(pcOf);
+    *steps = 0;
+    return runtimeError(vm, 0, "out of memory");
+  }
+  for (pc = 0, n = 0; pc < m->ncode; pc += CODE_WIDE(CODE_OP(m->code[pc])) ? 2 : 1, n++) {
+    index[pc] = n;
+    pcOf[n] = pc;
+  }
+  for (pc = 0, n = 0; pc < m->ncode; pc += CODE_WIDE(CODE_OP(m->code[pc])) ? 2 : 1, n++) {
+    unsigned int word = m->code[pc];
+    OpCode op = CODE_OP(word);
+    code[n].op = handler[op];
+    code[n].a = (unsigned char) CODE_A(word);
+    code[n].b = (unsigned char) CODE_B(word);
+    code[n].c = (unsigned char) CODE_C(word);
+    if (op == OP_LOADI)
+      code[n].w = CODE_SBX(word);
+    else if (op == OP_JMP || op == OP_JZ || op == OP_JNZ)
+      code[n].w = index[m->code[pc+1]];
+    else if (CODE_WIDE(op))
+      code[n].w = (int) m->code[pc+1];
+    else
+      code[n].w = 0;
+  }
+
+  ip = code;
+  DISPATCH();
+L_HALT:
+  ok = TRUE;
+  goto done;
+L_LOADI: RA.vint = ip->w; NEXT();
+L_ITOR: RA.vreal = (double) RB.vint; NEXT();
+L_RTOI: RA.vint = realToInt(RB.vreal); NEXT();
+L_ADDI: RA.vint = WRAP(RB.vint, +, RC.vint); NEXT();
+L_SUBI: RA.vint = WRAP(RB.vint, -, RC.vint); NEXT();
+L_MULI: RA.vint = WRAP(RB.vint, *, RC.vint); NEXT();
+L_DIVI:
+  if (RC.vint == 0) {
+    runtimeError(vm, pcOf[ip - code], "division by zero");
+    goto done;
+  }
+  RA.vint = (RC.vint == -1) ? WRAP(0, -, RB.vint) : RB.vint / RC.vint;
+  NEXT();
+L_ADDR: RA.vreal = RB.vreal + RC.vreal; NEXT();
+L_SUBR: RA.vreal = RB.vreal - RC.vreal; NEXT();
+L_MULR: RA.vreal = RB.vreal * RC.vreal; NEXT();
+L_DIVR: RA.vreal = RB.vreal / RC.vreal; NEXT();
+L_LTI: RA.vint = RB.vint < RC.vint; NEXT();
+L_LEI: RA.vint = RB.vint <= RC.vint; NEXT();
+L_GTI: RA.vint = RB.vint > RC.vint; NEXT();
+L_GEI: RA.vint = RB.vint >= RC.vint; NEXT();
+L_EQI: RA.vint = RB.vint == RC.vint; NEXT();
+L_NEI: RA.vint = RB.vint != RC.vint; NEXT();
+L_LTR: RA.vint = RB.vreal < RC.vreal; NEXT();
+L_LER: RA.vint = RB.vreal <= RC.vreal; NEXT();
+L_GTR: RA.vint = RB.vreal > RC.vreal; NEXT();
+L_GER: RA.vint = RB.vreal >= RC.vreal; NEXT();
+L_EQR: RA.vint = RB.vreal == RC.vreal; NEXT();
+L_NER: RA.vint = RB.vreal != RC.vreal; NEXT();
+L_TESTR: RA.vint = RB.vreal != 0.0; NEXT();
+L_AND: RA.vint = RB.vint != 0 && RC.vint != 0; NEXT();
+L_OR: RA.vint = RB.vint != 0 || RC.vint != 0; NEXT();
+L_WRITEI: vmWriteInt(vm, RA.vint); NEXT();
+L_WRITER: vmWriteReal(vm, RA.vreal); NEXT();
+L_LOADK: RA = consts[ip->w]; NEXT();
+L_GET: RA = mem[ip->w]; NEXT();
+L_PUT: mem[ip->w] = RA; NEXT();
+L_JMP: ip = code + ip->w; DISPATCH();
+L_JZ: ip = (RA.vint == 0) ? code + ip->w : ip + 1; DISPATCH();
+L_JNZ: ip = (RA.vint != 0) ? code + ip->w : ip + 1; DISPATCH();
+L_READI:
+  if (!vmRead(vm, (unsigned int) ip->w, FALSE)) {
+    runtimeError(vm, pcOf[ip - code], "invalid input");
+    goto done;
+  }
+  NEXT();
+L_READR:
+  if (!vmRead(vm, (unsigned int) ip->w, TRUE)) {
+    runtimeError(vm, pcOf[ip - code], "invalid input");
+    goto done;
+  }
+  NEXT();
+
+done:
+  *steps = count;
+  free(code);
+  free(index);
+  free(pcOf);
+  return ok;
+}
+
+#undef RA
+#undef RB
+#undef RC
+#undef DISPATCH
+#undef NEXT
+
+#else
+#define runThreaded runSwitch
+#endif
+
+/*************************************************/
+/*****************  Execucao  ********************/
+/*************************************************/
+
+int runCode(const CodeModule * m, FILE * in, FILE * out, VmDispatch dispatch, long long * steps) {
+  VmState * vm = (VmState *) malloc(sizeof(VmState));
+  long long count = 0;
+  int ok;
+  if (vm == NULL || (vm->mem = (NumValue *) calloc(m->nslots + 1, sizeof(NumValue))) == NULL) {
+    fprintf(stderr, "Runtime error: out of memory\n");
+    free(vm);
+    return FALSE;
+  }
+  vm->module = m;
+  memset(vm->reg, 0, sizeof(vm->reg));
+  vm->in = in;
+  vm->out = out;
+  vm->outLen = 0;
+  ok = (dispatch == VM_SWITCH) ? runSwitch(vm, &count) : runThreaded(vm, &count);
+  vmFlush(vm);
+  if (steps != NULL)
+    *steps = count;
+  free(vm->mem);
+  free(vm);
+  return ok;
+}
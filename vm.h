@@ -0,0 +1,46 @@
+/****************************************************/
+/* File: vm.h                                       */
+/* Bytecode interpreter for the P- compiler         */
+/****************************************************/
+
+#ifndef _VM_H_
+#define _VM_H_
+
+/* Interpretador do bytecode de code.h. As variaveis ficam num array
+   plano de NumValue indexado pela localizacao de memoria (memloc), que
+   comeca zerado; os valores intermediarios, nos CODE_MAXREGS
+   registradores. ler le um numero da entrada e mostrar escreve o valor
+   e um '\n' na saida, acumulada num buffer entregue antes de cada
+   leitura e no fim. A aritmetica inteira da a volta em 64 bits e a
+   conversao de real para inteiro trunca, saturando fora da faixa. */
+
+/* Despacho das instrucoes. VM_THREADED traduz antes o modulo para um
+   array de instrucoes com o endereco do tratador de cada uma e desvia
+   de um tratador para o seguinte por goto computado (extensao do GCC;
+   sem ela eh VM_SWITCH). VM_SWITCH eh o laco simples, que decodifica a
+   palavra e passa por um switch a cada instrucao. */
+typedef enum {VM_THREADED, VM_SWITCH} VmDispatch;
+
+/* Le de f um modulo gravado por codeGen para m, que deve estar zerado,
+   e o confere com verifyCode. Retorna FALSE se o arquivo for de outra
+   versao ou maquina, estiver truncado ou for invalido, ou se faltar
+   memoria. */
+int loadCode(CodeModule *, FILE *);
+
+/* Confere que o modulo pode ser executado sem sair dos seus arrays:
+   operacoes conhecidas, posicoes de memoria, constantes e destinos de
+   desvio validos (inicio de instrucao) e a ultima instrucao em OP_HALT
+   ou OP_JMP. Os modulos de codeGen ja sao validos. */
+int verifyCode(const CodeModule *);
+
+/* Libera os arrays de um modulo de loadCode */
+void freeCode(CodeModule *);
+
+/* Executa o modulo (valido), lendo de in e escrevendo em out. Em steps,
+   se nao for NULL, fica o numero de instrucoes executadas. Retorna
+   FALSE depois de mostrar em stderr um erro de execucao (divisao
+   inteira por zero, entrada invalida ou falta de memoria), com a linha
+   do fonte. */
+int runCode(const CodeModule *, FILE * in, FILE * out, VmDispatch, long long * steps);
+
+#endif